@@ -0,0 +1,177 @@
+/*!
+ *  @file batchcheck.cpp
+ *
+ *  Headless round-trip check of every family/style in the font database.
+ *
+ */
+
+#include "batchcheck.h"
+#include "timing.h"
+
+#include <QFile>
+#include <QFont>
+#include <QFontDatabase>
+#include <QFontInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRunnable>
+#include <QSettings>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QThreadPool>
+#include <QVariant>
+#include <QVector>
+#include <QDebug>
+
+#include <cstring>
+
+bool batchModeRequested(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--batch") || !strncmp(argv[i], "--batch=", 8)
+                || !strcmp(argv[i], "-batch") || !strncmp(argv[i], "-batch=", 7)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+
+struct FaceResult {
+    QJsonObject record;
+    bool passed;
+};
+
+class FamilyCheck : public QRunnable
+{
+public:
+    FamilyCheck(const QString &family, const QString &settingsPath, QVector<FaceResult> *results)
+        : family(family)
+        , settingsPath(settingsPath)
+        , results(results)
+    {}
+
+    void run() override;
+
+private:
+    const QString family;
+    const QString settingsPath;
+    QVector<FaceResult> *results;
+};
+
+void FamilyCheck::run()
+{
+    QFontDatabase db;
+    const QStringList styles = db.styles(family);
+    QList<QFont> fonts;
+
+    // Store all faces of this family the way Dialog::setFont() does, in
+    // native and in string form, and flush them to disk once.
+    {
+        QSettings store(settingsPath, QSettings::IniFormat);
+        for (int i = 0; i < styles.size(); ++i) {
+            const QFont font = db.font(family, styles.at(i), 12);
+            fonts.append(font);
+            store.setValue(QStringLiteral("native/%1").arg(i), font);
+            store.setValue(QStringLiteral("string/%1").arg(i), font.toString());
+        }
+        store.sync();
+    }
+    // QSettings caches the values it wrote for each file within the process;
+    // read back from a copy so the values are really parsed from the INI text.
+    const QString readbackPath = settingsPath + QStringLiteral(".readback");
+    QFile::copy(settingsPath, readbackPath);
+    QSettings restore(readbackPath, QSettings::IniFormat);
+
+    for (int i = 0; i < styles.size(); ++i) {
+        const QFont &font = fonts.at(i);
+        const QString styleString = db.styleString(font);
+        const QString faceStyle = QFontInfo(font).styleName();
+
+        const QVariant prefFont = restore.value(QStringLiteral("native/%1").arg(i));
+        const QFont native = prefFont.value<QFont>();
+        const bool nativeOk = prefFont.canConvert<QFont>() && native == font
+            && db.styleString(native) == styleString;
+
+        QFont fromString;
+        const QString description = restore.value(QStringLiteral("string/%1").arg(i)).toString();
+        const bool stringOk = fromString.fromString(description) && fromString == font
+            && db.styleString(fromString) == styleString;
+
+        // the "lower button" of the Dialog: family, integer weight and italic flag only
+        const QFont clone(font.family(), font.pointSize(), font.weight(), font.italic());
+        const QString cloneStyle = QFontInfo(clone).styleName();
+        const bool cloneOk = cloneStyle == faceStyle;
+
+        QJsonObject record;
+        record.insert(QStringLiteral("family"), family);
+        record.insert(QStringLiteral("style"), styles.at(i));
+        record.insert(QStringLiteral("styleString"), styleString);
+        record.insert(QStringLiteral("weight"), font.weight());
+        record.insert(QStringLiteral("italic"), font.italic());
+        record.insert(QStringLiteral("toString"), font.toString());
+        record.insert(QStringLiteral("native"), nativeOk);
+        record.insert(QStringLiteral("string"), stringOk);
+        record.insert(QStringLiteral("clone"), cloneOk);
+        if (!cloneOk) {
+            record.insert(QStringLiteral("cloneResolvesTo"), cloneStyle);
+        }
+        results->append(FaceResult{record, nativeOk && stringOk && cloneOk});
+    }
+}
+
+} // namespace
+
+int runBatchCheck(const QString &reportFile, int jobs)
+{
+    QFile report;
+    bool opened;
+    if (reportFile.isEmpty() || reportFile == QLatin1String("-")) {
+        opened = report.open(stdout, QIODevice::WriteOnly);
+    } else {
+        report.setFileName(reportFile);
+        opened = report.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    }
+    if (!opened) {
+        qWarning() << "Cannot open" << reportFile << "for writing:" << report.errorString();
+        return 2;
+    }
+    QTemporaryDir scratch;
+    if (!scratch.isValid()) {
+        qWarning() << "Cannot create a temporary directory for the settings round trips";
+        return 2;
+    }
+
+    init_HRTime();
+    HRTime_tic();
+
+    const QStringList families = QFontDatabase().families();
+    // one result slot per family, so the workers never share a container
+    QVector<QVector<FaceResult> > results(families.size());
+    QThreadPool pool;
+    if (jobs > 0) {
+        pool.setMaxThreadCount(jobs);
+    }
+    for (int i = 0; i < families.size(); ++i) {
+        const QString path = scratch.filePath(QStringLiteral("family-%1.ini").arg(i));
+        pool.start(new FamilyCheck(families.at(i), path, &results[i]));
+    }
+    pool.waitForDone();
+
+    int faces = 0, failures = 0;
+    for (const auto &familyResults : qAsConst(results)) {
+        for (const FaceResult &face : familyResults) {
+            report.write(QJsonDocument(face.record).toJson(QJsonDocument::Compact));
+            report.write("\n");
+            faces += 1;
+            failures += face.passed ? 0 : 1;
+        }
+    }
+    report.close();
+
+    qInfo() << "Checked" << faces << "faces in" << families.size() << "families with"
+        << pool.maxThreadCount() << "threads in" << HRTime_toc() << "seconds;"
+        << failures << "faces failed at least one round trip";
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,31 @@
+/*!
+ *  @file batchcheck.h
+ *
+ *  Headless round-trip check of every family/style in the font database.
+ *
+ */
+
+#ifndef BATCHCHECK_H
+#define BATCHCHECK_H
+
+#include <QString>
+
+/**
+ * Returns true if the command line requests the batch mode. This has to be
+ * known before the QApplication is created, to select the offscreen platform.
+ */
+bool batchModeRequested(int argc, char *argv[]);
+
+/**
+ * Runs the round trips of Dialog::setFont() and Dialog::setFontFromSpecs()
+ * (native QFont and QFont::toString() through QSettings, and the
+ * family+weight+italic clone) for every style of every family, using up
+ * to @p jobs worker threads (all cores when <= 0).
+ * One JSON object per face is written to @p reportFile ("-" for stdout).
+ *
+ * @return the process exit code: 0 if all faces survived all round trips,
+ * 1 if any failed, 2 on I/O errors.
+ */
+int runBatchCheck(const QString &reportFile, int jobs);
+
+#endif // BATCHCHECK_H
@@ -0,0 +1,250 @@
+/*!
+ *  @file benchmark.cpp
+ *
+ *  A small micro-benchmark harness on top of timing.c.
+ *
+ */
+
+#include "benchmark.h"
+#include "timing.h"
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QTextStream>
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+
+namespace Benchmark {
+
+namespace {
+
+struct Entry {
+    QString name;
+    Body body;
+};
+
+QVector<Entry> &registry()
+{
+    static QVector<Entry> entries;
+    return entries;
+}
+
+double timeBody(const Body &body, quint64 iterations)
+{
+    HRTime_tic();
+    body(iterations);
+    return HRTime_toc();
+}
+
+// Scale the iteration count until a sample lasts at least minSampleSeconds,
+// running for at least warmupSeconds in total so caches and clocks settle.
+quint64 calibrate(const Body &body)
+{
+    const Settings &s = settings();
+    quint64 iterations = 1;
+    double spent = 0;
+    forever {
+        const double elapsed = timeBody(body, iterations);
+        spent += elapsed;
+        if (elapsed >= s.minSampleSeconds) {
+            if (spent >= s.warmupSeconds) {
+                break;
+            }
+            continue;
+        }
+        // aim a little beyond the target, but grow at least 2x and at most 100x per step
+        quint64 next = elapsed > 0 ? quint64(iterations * 1.2 * s.minSampleSeconds / elapsed) : iterations * 10;
+        next = qBound(iterations * 2, next, iterations * 100);
+        if (next > (quint64(1) << 40)) {
+            break;
+        }
+        iterations = next;
+    }
+    return iterations;
+}
+
+QVector<double> sample(const Body &body, quint64 iterations, int samples)
+{
+    QVector<double> perIteration;
+    perIteration.reserve(samples);
+    for (int i = 0; i < samples; ++i) {
+        perIteration.append(timeBody(body, iterations) / iterations);
+    }
+    return perIteration;
+}
+
+// The cost of an empty loop, per iteration; measured once.
+double loopOverhead()
+{
+    static double overhead = -1;
+    if (overhead < 0) {
+        const Body empty = [](quint64 iterations) {
+            for (quint64 i = 0; i < iterations; ++i) {
+                clobberMemory();
+            }
+        };
+        overhead = median(sample(empty, calibrate(empty), settings().samples));
+    }
+    return overhead;
+}
+
+} // namespace
+
+double median(QVector<double> values)
+{
+    if (values.isEmpty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    const int n = values.size();
+    return (n & 1) ? values.at(n / 2) : (values.at(n / 2 - 1) + values.at(n / 2)) / 2;
+}
+
+QString formatSeconds(double seconds)
+{
+    const double abs = std::fabs(seconds);
+    if (abs < 1e-6) {
+        return QString::number(seconds * 1e9, 'f', 2) + QStringLiteral("ns");
+    } else if (abs < 1e-3) {
+        return QString::number(seconds * 1e6, 'f', 3) + QStringLiteral("us");
+    } else if (abs < 1) {
+        return QString::number(seconds * 1e3, 'f', 3) + QStringLiteral("ms");
+    }
+    return QString::number(seconds, 'f', 3) + QStringLiteral("s");
+}
+
+Settings &settings()
+{
+    static Settings s;
+    return s;
+}
+
+void registerBenchmark(const QString &name, const Body &body)
+{
+    for (Entry &entry : registry()) {
+        if (entry.name == name) {
+            entry.body = body;
+            return;
+        }
+    }
+    registry().append(Entry{name, body});
+}
+
+QVector<Result> run(const QString &filter)
+{
+    init_HRTime();
+    const QRegularExpression select(filter);
+    const QRegularExpression userSelect(settings().filter);
+    QVector<Result> results;
+
+    for (const Entry &entry : qAsConst(registry())) {
+        if ((!filter.isEmpty() && !select.match(entry.name).hasMatch())
+                || (!settings().filter.isEmpty() && !userSelect.match(entry.name).hasMatch())) {
+            continue;
+        }
+        const double overhead = loopOverhead();
+        const quint64 iterations = calibrate(entry.body);
+        QVector<double> times = sample(entry.body, iterations, settings().samples);
+        for (double &t : times) {
+            t -= overhead;
+        }
+        const double med = median(times);
+        QVector<double> deviations;
+        deviations.reserve(times.size());
+        for (double t : qAsConst(times)) {
+            deviations.append(std::fabs(t - med));
+        }
+
+        Result result;
+        result.name = entry.name;
+        result.iterations = iterations;
+        result.samples = times.size();
+        result.median = med;
+        result.mad = median(deviations);
+        result.min = *std::min_element(times.constBegin(), times.constEnd());
+        result.max = *std::max_element(times.constBegin(), times.constEnd());
+        result.overhead = overhead;
+        result.allocations = -1;
+        if (settings().allocationCounter) {
+            // one more pass, untimed
+            const quint64 before = settings().allocationCounter();
+            entry.body(iterations);
+            result.allocations = double(settings().allocationCounter() - before) / iterations;
+        }
+        results.append(result);
+    }
+    return results;
+}
+
+void report(const QVector<Result> &results, Format format, QIODevice *device, bool header)
+{
+    QTextStream sink(device);
+    switch (format) {
+    case CsvFormat:
+        if (header) {
+            sink << "name,iterations,samples,median_s,mad_s,min_s,max_s,overhead_s,allocations\n";
+        }
+        for (const Result &r : results) {
+            sink << '"' << QString(r.name).replace(QLatin1Char('"'), QLatin1String("\"\"")) << '"'
+                << ',' << r.iterations << ',' << r.samples
+                << ',' << QString::number(r.median, 'g', 6) << ',' << QString::number(r.mad, 'g', 6)
+                << ',' << QString::number(r.min, 'g', 6) << ',' << QString::number(r.max, 'g', 6)
+                << ',' << QString::number(r.overhead, 'g', 6)
+                << ',' << (r.allocations >= 0 ? QString::number(r.allocations, 'g', 6) : QString()) << '\n';
+        }
+        break;
+    case JsonFormat:
+        for (const Result &r : results) {
+            QJsonObject object;
+            object.insert(QStringLiteral("name"), r.name);
+            object.insert(QStringLiteral("iterations"), double(r.iterations));
+            object.insert(QStringLiteral("samples"), r.samples);
+            object.insert(QStringLiteral("median"), r.median);
+            object.insert(QStringLiteral("mad"), r.mad);
+            object.insert(QStringLiteral("min"), r.min);
+            object.insert(QStringLiteral("max"), r.max);
+            object.insert(QStringLiteral("overhead"), r.overhead);
+            if (r.allocations >= 0) {
+                object.insert(QStringLiteral("allocations"), r.allocations);
+            }
+            sink << QJsonDocument(object).toJson(QJsonDocument::Compact) << '\n';
+        }
+        break;
+    case TextFormat:
+        for (const Result &r : results) {
+            sink << r.name << ": " << formatSeconds(r.median) << " +/- " << formatSeconds(r.mad)
+                << " per iteration (" << r.samples << " samples of " << r.iterations << " iterations"
+                << "; range " << formatSeconds(r.min) << " - " << formatSeconds(r.max) << ")";
+            if (r.allocations >= 0) {
+                sink << ", " << QString::number(r.allocations, 'g', 4) << " allocations";
+            }
+            sink << '\n';
+        }
+        break;
+    }
+}
+
+void report(const QVector<Result> &results)
+{
+    // successive runs (one per font selection) accumulate in the same output
+    static bool reported = false;
+    const QString &output = settings().output;
+    QFile file;
+    if (output.isEmpty() || output == QLatin1String("-")) {
+        file.open(stdout, QIODevice::WriteOnly);
+    } else {
+        file.setFileName(output);
+        if (!file.open(QIODevice::WriteOnly | (reported ? QIODevice::Append : QIODevice::Truncate))) {
+            qWarning() << "Cannot write benchmark results to" << output << ":" << file.errorString();
+            return;
+        }
+    }
+    report(results, settings().format, &file, !reported);
+    reported = true;
+}
+
+} // namespace Benchmark
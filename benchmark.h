@@ -0,0 +1,128 @@
+/*!
+ *  @file benchmark.h
+ *
+ *  A small micro-benchmark harness on top of timing.c: named cases,
+ *  warm-up, automatic iteration scaling and repeated samples summarised
+ *  by their median and median absolute deviation.
+ *
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QString>
+#include <QVector>
+
+#include <functional>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#	include <intrin.h>
+#endif
+
+class QIODevice;
+
+namespace Benchmark {
+
+/**
+ * Make the compiler believe that @p value is read, so that the computation
+ * that produced it cannot be optimised away.
+ */
+template <typename T>
+inline void doNotOptimize(const T &value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r"(&value) : "memory");
+#else
+    static volatile const void *sink;
+    sink = &value;
+    _ReadWriteBarrier();
+#endif
+}
+
+/**
+ * Make the compiler believe that all memory may have been read and written.
+ */
+inline void clobberMemory()
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : : "memory");
+#else
+    _ReadWriteBarrier();
+#endif
+}
+
+/**
+ * The body of a benchmark runs the measured operation @p iterations times.
+ * The cost of the loop itself is measured separately and subtracted.
+ */
+typedef std::function<void(quint64 iterations)> Body;
+
+enum Format {
+    TextFormat,
+    CsvFormat,
+    JsonFormat
+};
+
+struct Settings {
+    double warmupSeconds = 0.05;    ///< minimal duration of the warm-up phase
+    double minSampleSeconds = 0.01; ///< the iteration count is scaled until a sample takes this long
+    int samples = 15;
+    QString filter;                 ///< regular expression selecting the benchmarks to run
+    Format format = TextFormat;
+    QString output;                 ///< report file; empty or "-" for stdout
+    /// returns the number of heap allocations so far; set by executables
+    /// that count them, to report the allocations per iteration
+    std::function<quint64()> allocationCounter;
+};
+
+struct Result {
+    QString name;
+    quint64 iterations;     ///< per sample
+    int samples;
+    double median;          ///< seconds per iteration, loop overhead subtracted
+    double mad;             ///< median absolute deviation of the per-iteration times
+    double min;
+    double max;
+    double overhead;        ///< the subtracted loop cost per iteration
+    double allocations;     ///< heap allocations per iteration, -1 when not counted
+};
+
+/**
+ * The settings used by run(); initialised from the command line in main().
+ */
+Settings &settings();
+
+/**
+ * Register a benchmark under @p name, replacing any previous one of that name.
+ * Names are hierarchical by convention ("group/case").
+ */
+void registerBenchmark(const QString &name, const Body &body);
+
+/**
+ * Run the registered benchmarks whose names match @p filter (all when empty)
+ * and the settings().filter.
+ */
+QVector<Result> run(const QString &filter = QString());
+
+/**
+ * Write @p results in the format and to the destination given by settings().
+ * A process can report several times: the output file is truncated by the
+ * first report and appended to by the later ones, the CSV header is only
+ * written once, and JSON is written as one object per line.
+ */
+void report(const QVector<Result> &results);
+void report(const QVector<Result> &results, Format format, QIODevice *device, bool header = true);
+
+/**
+ * @return the median of @p values, 0 when there are none
+ */
+double median(QVector<double> values);
+
+/**
+ * @return @p seconds in ns, us, ms or s, whichever reads best
+ */
+QString formatSeconds(double seconds);
+
+} // namespace Benchmark
+
+#endif // BENCHMARK_H
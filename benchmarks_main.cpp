@@ -0,0 +1,403 @@
+/*!
+ *  @file benchmarks_main.cpp
+ *
+ *  The fontbenchmarks executable: times the QFont operations fontweightissue
+ *  exercises, on a cold and on a warm font cache, and counts their heap
+ *  allocations. Runs without a display.
+ *
+ */
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QFont>
+#include <QFontDatabase>
+#include <QFontInfo>
+#include <QFontMetrics>
+#include <QRandomGenerator>
+#include <QRawFont>
+#include <QDebug>
+
+#include <QtGui/private/qfont_p.h>
+
+#include <cstdlib>
+#include <new>
+
+#include "benchmark.h"
+#include "fontdescription.h"
+#include "kwidgetsaddons/fontcatalog_p.h"
+
+#include "timing.c"
+
+// Every heap allocation made by this process, whether through operator new
+// or, where the C library lets us interpose on it, through malloc() as
+// QString, QByteArray and the other Qt containers do.
+static QBasicAtomicInteger<quint64> allocationCount = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    allocationCount.fetchAndAddRelaxed(1);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    allocationCount.fetchAndAddRelaxed(1);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    allocationCount.fetchAndAddRelaxed(1);
+    return __libc_realloc(ptr, size);
+}
+}
+#else
+void *operator new(std::size_t size)
+{
+    allocationCount.fetchAndAddRelaxed(1);
+    if (void *ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    allocationCount.fetchAndAddRelaxed(1);
+    return std::malloc(size ? size : 1);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    std::free(ptr);
+}
+#endif
+
+static quint64 allocations()
+{
+    return allocationCount.load();
+}
+
+// The fields from which every iteration builds a new QFont: a copy would
+// share the QFontPrivate, and with it the font engine the previous
+// iteration resolved, so only "construct" shows what the others add.
+struct FontSpec {
+    QString family;
+    QString styleName;
+    qreal pointSize;
+    int weight;
+    bool italic;
+
+    QFont make() const
+    {
+        QFont font(family, -1, weight, italic);
+        font.setPointSizeF(pointSize);
+        if (!styleName.isEmpty()) {
+            font.setStyleName(styleName);
+        }
+        return font;
+    }
+};
+
+// Registers "warm/<name>" and "cold/<name>"; the cold case empties the
+// font engine cache before every operation, and includes the time that
+// takes, which "cold/clearCache" shows by itself.
+template <typename Operation>
+static void registerFontBenchmark(const QString &name, Operation operation)
+{
+    Benchmark::registerBenchmark(QStringLiteral("warm/") + name, [operation](quint64 iterations) {
+        for (quint64 i = 0 ; i < iterations ; ++i) {
+            operation();
+        }
+    });
+    Benchmark::registerBenchmark(QStringLiteral("cold/") + name, [operation](quint64 iterations) {
+        for (quint64 i = 0 ; i < iterations ; ++i) {
+            QFontCache::instance()->clear();
+            operation();
+        }
+    });
+}
+
+static void registerFontBenchmarks(const FontSpec &spec)
+{
+    const QFont prototype = spec.make();
+    const QString descriptor = prototype.toString();
+
+    Benchmark::registerBenchmark(QStringLiteral("cold/clearCache"), [](quint64 iterations) {
+        for (quint64 i = 0 ; i < iterations ; ++i) {
+            QFontCache::instance()->clear();
+        }
+    });
+    registerFontBenchmark(QStringLiteral("construct"), [spec]() {
+        Benchmark::doNotOptimize(spec.make());
+    });
+    registerFontBenchmark(QStringLiteral("copy+setBold"), [prototype]() {
+        QFont font(prototype);
+        font.setBold(true);
+        Benchmark::doNotOptimize(font);
+    });
+    registerFontBenchmark(QStringLiteral("key"), [prototype]() {
+        Benchmark::doNotOptimize(prototype.key());
+    });
+    registerFontBenchmark(QStringLiteral("toString"), [prototype]() {
+        Benchmark::doNotOptimize(prototype.toString());
+    });
+    registerFontBenchmark(QStringLiteral("fromString"), [descriptor]() {
+        QFont font;
+        font.fromString(descriptor);
+        Benchmark::doNotOptimize(font);
+    });
+    registerFontBenchmark(QStringLiteral("QFontInfo"), [spec]() {
+        const QFontInfo info(spec.make());
+        Benchmark::doNotOptimize(info.family());
+    });
+    registerFontBenchmark(QStringLiteral("QFontMetrics"), [spec]() {
+        const QFontMetrics metrics(spec.make());
+        Benchmark::doNotOptimize(metrics.height());
+    });
+    registerFontBenchmark(QStringLiteral("QRawFont::fromFont"), [spec]() {
+        Benchmark::doNotOptimize(QRawFont::fromFont(spec.make()));
+    });
+    registerFontBenchmark(QStringLiteral("QFontDatabase::font"), [spec]() {
+        Benchmark::doNotOptimize(QFontDatabase().font(spec.family, spec.styleName, qRound(spec.pointSize)));
+    });
+    registerFontBenchmark(QStringLiteral("QFontDatabase::styleString"), [prototype]() {
+        Benchmark::doNotOptimize(QFontDatabase().styleString(prototype));
+    });
+    // what the application uses instead of the two above
+    registerFontBenchmark(QStringLiteral("FontCatalog::font"), [spec]() {
+        Benchmark::doNotOptimize(FontCatalog::instance()->font(spec.family, spec.styleName, qRound(spec.pointSize)));
+    });
+    registerFontBenchmark(QStringLiteral("FontCatalog::styleString"), [prototype]() {
+        Benchmark::doNotOptimize(FontCatalog::instance()->styleString(prototype));
+    });
+}
+
+static void registerDescriptionBenchmarks(const QFont &prototype)
+{
+    const QString descriptor = prototype.toString();
+
+    Benchmark::registerBenchmark(QStringLiteral("description/QFont::toString"), [prototype](quint64 iterations) {
+        for (quint64 i = 0 ; i < iterations ; ++i) {
+            Benchmark::doNotOptimize(prototype.toString());
+        }
+    });
+    Benchmark::registerBenchmark(QStringLiteral("description/format"), [prototype](quint64 iterations) {
+        const QString family = prototype.family();
+        const QString styleName = prototype.styleName();
+        QChar buffer[256];
+        for (quint64 i = 0 ; i < iterations ; ++i) {
+            const FontDescription description = FontDescription::fromFont(prototype, family, styleName);
+            Benchmark::doNotOptimize(description.format(buffer, 256));
+            Benchmark::clobberMemory();
+        }
+    });
+    Benchmark::registerBenchmark(QStringLiteral("description/QFont::fromString"), [descriptor](quint64 iterations) {
+        for (quint64 i = 0 ; i < iterations ; ++i) {
+            QFont font;
+            font.fromString(descriptor);
+            Benchmark::doNotOptimize(font);
+        }
+    });
+    Benchmark::registerBenchmark(QStringLiteral("description/parse"), [descriptor](quint64 iterations) {
+        for (quint64 i = 0 ; i < iterations ; ++i) {
+            FontDescription description;
+            Benchmark::doNotOptimize(description.parse(descriptor));
+            Benchmark::doNotOptimize(description);
+        }
+    });
+    Benchmark::registerBenchmark(QStringLiteral("description/parse+applyTo"), [descriptor](quint64 iterations) {
+        for (quint64 i = 0 ; i < iterations ; ++i) {
+            QFont font;
+            FontDescription::fromString(descriptor, &font);
+            Benchmark::doNotOptimize(font);
+        }
+    });
+}
+
+static QString randomField(QRandomGenerator &random)
+{
+    static const char *const fields[] = {
+        "", " ", "0", "1", "-1", "2", "5", "12", "50", "63", "75", "99", "100", "-100", "+3", " 7 ",
+        "2147483647", "2147483648", "-2147483649", "0x10", "1e3", "12.5", "10.25", "-0", "nan", "inf",
+        "1,5", "abc", "Bold", "Semi Bold", "Regular", "Italic", " Oblique "
+    };
+    const int n = int(sizeof(fields) / sizeof(fields[0]));
+    switch (random.bounded(4)) {
+    case 0:
+        return QString::number(random.bounded(-1000, 1000));
+    case 1:
+        return QString::number(random.bounded(2000.0) - 10, 'g', random.bounded(1, 10));
+    default:
+        return QString::fromLatin1(fields[random.bounded(n)]);
+    }
+}
+
+static QString randomDescription(QRandomGenerator &random, const QStringList &families)
+{
+    QString text;
+    if (random.bounded(8) == 0) {
+        text += QLatin1Char(' ');
+    }
+    switch (random.bounded(6)) {
+    case 0:
+        break;
+    case 1:
+        text += QStringLiteral("Caf\u00e9 \u65b0\u7d30\u660e\u9ad4");
+        break;
+    default:
+        text += families.at(random.bounded(families.size()));
+        break;
+    }
+    // mostly the counts QFont::fromString() accepts
+    static const int counts[] = { 1, 2, 3, 8, 9, 9, 10, 10, 10, 11, 11, 11, 12, 13 };
+    const int count = counts[random.bounded(int(sizeof(counts) / sizeof(counts[0])))];
+    for (int i = 1; i < count; ++i) {
+        text += QLatin1Char(',') + randomField(random);
+    }
+    if (random.bounded(8) == 0) {
+        text += QStringLiteral("\t");
+    }
+    return text;
+}
+
+static bool sameFont(const QFont &a, const QFont &b)
+{
+    return a == b && a.resolve() == b.resolve() && a.toString() == b.toString()
+        && a.styleName() == b.styleName() && a.pixelSize() == b.pixelSize();
+}
+
+static void ignoreMessages(QtMsgType, const QMessageLogContext &, const QString &)
+{
+}
+
+// Parses random, partly invalid, descriptions with QFont::fromString() and
+// with FontDescription, and compares the results and what toString() and
+// FontDescription::format() make of them.
+static int checkDescriptionEquivalence(int samples, const QFont &prototype)
+{
+    QStringList families = QFontDatabase().families();
+    if (families.isEmpty()) {
+        families << QStringLiteral("Sans");
+    }
+    QRandomGenerator random(20201016);
+    int mismatches = 0;
+    const QtMessageHandler handler = qInstallMessageHandler(ignoreMessages);
+    QStringList failures;
+    for (int i = 0; i < samples; ++i) {
+        const QString text = randomDescription(random, families);
+        // start from a fresh font and from one with everything resolved
+        QFont expected = (i & 1) ? prototype : QFont();
+        QFont actual = expected;
+        const bool expectedOk = expected.fromString(text);
+        const bool actualOk = FontDescription::fromString(text, &actual);
+        bool same = expectedOk == actualOk && sameFont(expected, actual);
+        if (same && expectedOk) {
+            same = FontDescription::toString(actual) == actual.toString();
+        }
+        if (!same) {
+            mismatches += 1;
+            if (failures.size() < 10) {
+                failures << text;
+            }
+        }
+    }
+    qInstallMessageHandler(handler);
+    for (const QString &text : qAsConst(failures)) {
+        qWarning() << "FontDescription differs from QFont::fromString() for" << text;
+    }
+    qInfo() << "FontDescription parses" << samples - mismatches << "of" << samples
+        << "random descriptions like QFont::fromString()";
+    return mismatches;
+}
+
+int main(int argc, char *argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Times QFont operations on a cold and a warm font cache."));
+    parser.addHelpOption();
+    QCommandLineOption fontOption(QStringLiteral("font"),
+        QStringLiteral("the font to use, as given by QFont::toString() (default: the application font)"), QStringLiteral("font"));
+    parser.addOption(fontOption);
+    QCommandLineOption benchmarkFilter(QStringLiteral("benchmark-filter"),
+        QStringLiteral("only run the benchmarks whose name matches <regexp>"), QStringLiteral("regexp"));
+    parser.addOption(benchmarkFilter);
+    QCommandLineOption benchmarkFormat(QStringLiteral("benchmark-format"),
+        QStringLiteral("benchmark report format: text (default), csv or json"), QStringLiteral("format"));
+    parser.addOption(benchmarkFormat);
+    QCommandLineOption benchmarkOutput(QStringLiteral("benchmark-output"),
+        QStringLiteral("append the benchmark reports to <file> instead of writing them to stdout"), QStringLiteral("file"));
+    parser.addOption(benchmarkOutput);
+    QCommandLineOption benchmarkSamples(QStringLiteral("benchmark-samples"),
+        QStringLiteral("number of timed samples per benchmark (default: 15)"), QStringLiteral("N"));
+    parser.addOption(benchmarkSamples);
+    QCommandLineOption fuzzDescriptions(QStringLiteral("fuzz-descriptions"),
+        QStringLiteral("compare FontDescription with QFont::fromString() on <N> random descriptions first (default: 10000, 0 to skip)"),
+        QStringLiteral("N"), QStringLiteral("10000"));
+    parser.addOption(fuzzDescriptions);
+    parser.process(app);
+
+    Benchmark::Settings &settings = Benchmark::settings();
+    settings.filter = parser.value(benchmarkFilter);
+    settings.output = parser.value(benchmarkOutput);
+    if (parser.value(benchmarkFormat) == QLatin1String("csv")) {
+        settings.format = Benchmark::CsvFormat;
+    } else if (parser.value(benchmarkFormat) == QLatin1String("json")) {
+        settings.format = Benchmark::JsonFormat;
+    }
+    if (parser.value(benchmarkSamples).toInt() > 0) {
+        settings.samples = parser.value(benchmarkSamples).toInt();
+    }
+    settings.allocationCounter = allocations;
+
+    QFont font = QGuiApplication::font();
+    if (parser.isSet(fontOption) && !font.fromString(parser.value(fontOption))) {
+        qWarning() << "Cannot use the font" << parser.value(fontOption);
+        return 1;
+    }
+    FontSpec spec;
+    spec.family = font.family();
+    spec.styleName = font.styleName();
+    if (spec.styleName.isEmpty()) {
+        // QFontDatabase::font() needs one
+        spec.styleName = QFontDatabase().styleString(font);
+    }
+    spec.pointSize = font.pointSizeF() > 0 ? font.pointSizeF() : 12;
+    spec.weight = font.weight();
+    spec.italic = font.italic();
+    qInfo() << "Benchmarking with" << spec.make().toString();
+
+    const int fuzzSamples = parser.value(fuzzDescriptions).toInt();
+    const int mismatches = fuzzSamples > 0 ? checkDescriptionEquivalence(fuzzSamples, spec.make()) : 0;
+
+    registerFontBenchmarks(spec);
+    registerDescriptionBenchmarks(spec.make());
+    Benchmark::report(Benchmark::run());
+    return mismatches > 0 ? 1 : 0;
+}
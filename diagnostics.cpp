@@ -0,0 +1,325 @@
+/*!
+ *  @file diagnostics.cpp
+ *
+ *  Structured diagnostic records, collected in a lock-free ring buffer and
+ *  written by a background thread as text or JSON lines.
+ *
+ */
+
+#include "diagnostics.h"
+
+#include <QAtomicPointer>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QStringList>
+#include <QThread>
+#include <QDebug>
+
+#include <cstdio>
+
+namespace Diagnostics {
+
+QAtomicInteger<quint32> enabledCategories;
+
+struct Record::Data {
+    Category category;
+    const char *event;
+    qint64 timestamp;   // nanoseconds since start()
+    QVector<QPair<const char *, QVariant> > fields;
+};
+
+namespace {
+
+// A bounded multi-producer, multi-consumer queue after Dmitry Vyukov's
+// design: every cell carries a sequence number that tells producers and
+// consumers whether it is theirs to fill or to empty, so a push or pop is
+// a single compare-and-swap on the position in the common case and never
+// blocks. When the queue is full the record is dropped.
+class RecordQueue
+{
+public:
+    explicit RecordQueue(quintptr capacity)
+        : cells(new Cell[capacity])
+        , mask(capacity - 1)
+    {
+        Q_ASSERT((capacity & mask) == 0);
+        for (quintptr i = 0; i < capacity; ++i) {
+            cells[i].sequence.store(i);
+        }
+    }
+
+    ~RecordQueue()
+    {
+        while (Record::Data *data = pop()) {
+            delete data;
+        }
+        delete[] cells;
+    }
+
+    bool push(Record::Data *data)
+    {
+        Cell *cell;
+        quintptr pos = enqueuePos.load();
+        for (;;) {
+            cell = &cells[pos & mask];
+            const qintptr diff = qintptr(cell->sequence.loadAcquire()) - qintptr(pos);
+            if (diff == 0) {
+                if (enqueuePos.testAndSetRelaxed(pos, pos + 1)) {
+                    break;
+                }
+                pos = enqueuePos.load();
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos.load();
+            }
+        }
+        cell->data = data;
+        cell->sequence.storeRelease(pos + 1);
+        return true;
+    }
+
+    Record::Data *pop()
+    {
+        Cell *cell;
+        quintptr pos = dequeuePos.load();
+        for (;;) {
+            cell = &cells[pos & mask];
+            const qintptr diff = qintptr(cell->sequence.loadAcquire()) - qintptr(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.testAndSetRelaxed(pos, pos + 1)) {
+                    break;
+                }
+                pos = dequeuePos.load();
+            } else if (diff < 0) {
+                return nullptr;
+            } else {
+                pos = dequeuePos.load();
+            }
+        }
+        Record::Data *data = cell->data;
+        cell->sequence.storeRelease(pos + mask + 1);
+        return data;
+    }
+
+private:
+    struct Cell {
+        QAtomicInteger<quintptr> sequence;
+        Record::Data *data = nullptr;
+    };
+
+    Cell *const cells;
+    const quintptr mask;
+    // keep producers and consumers off each other's cache line
+    char padding1[64];
+    QAtomicInteger<quintptr> enqueuePos;
+    char padding2[64];
+    QAtomicInteger<quintptr> dequeuePos;
+};
+
+const quintptr QueueCapacity = 4096;
+// how long the writer sleeps when the buffer is empty
+const unsigned long WriterIdleMs = 20;
+
+const char *categoryName(Category category)
+{
+    switch (category) {
+    case FontDetails:
+        return "details";
+    case Selection:
+        return "selection";
+    case Advances:
+        return "advances";
+    case Timing:
+        return "timing";
+    default:
+        return "unknown";
+    }
+}
+
+QByteArray formatRecord(const Record::Data &record, Format format)
+{
+    if (format == JsonFormat) {
+        QJsonObject object;
+        object.insert(QStringLiteral("t"), double(record.timestamp) * 1e-9);
+        object.insert(QStringLiteral("category"), QLatin1String(categoryName(record.category)));
+        object.insert(QStringLiteral("event"), QLatin1String(record.event));
+        for (const auto &field : record.fields) {
+            QJsonValue value = QJsonValue::fromVariant(field.second);
+            if (value.isNull() && !field.second.isNull()) {
+                value = field.second.toString();
+            }
+            object.insert(QLatin1String(field.first), value);
+        }
+        return QJsonDocument(object).toJson(QJsonDocument::Compact) + '\n';
+    }
+
+    QString line = QStringLiteral("%1 [%2] %3").arg(double(record.timestamp) * 1e-9, 0, 'f', 6)
+                   .arg(QLatin1String(categoryName(record.category)), QLatin1String(record.event));
+    for (const auto &field : record.fields) {
+        line += QLatin1Char(' ') + QLatin1String(field.first) + QLatin1Char('=');
+        const QString value = field.second.toString();
+        if (value.contains(QLatin1Char(' ')) || value.isEmpty()) {
+            line += QLatin1Char('"') + value + QLatin1Char('"');
+        } else {
+            line += value;
+        }
+    }
+    return line.toUtf8() + '\n';
+}
+
+class Writer : public QThread
+{
+public:
+    Writer(Format format)
+        : format(format)
+    {}
+
+    void run() override
+    {
+        for (;;) {
+            // read before draining, so nothing pushed before stop() is missed
+            const bool stopping = stopRequested.loadAcquire();
+            bool wrote = false;
+            while (Record::Data *record = queue.pop()) {
+                const QByteArray line = formatRecord(*record, format);
+                delete record;
+                if (output.write(line) != line.size()) {
+                    writeErrors += 1;
+                }
+                wrote = true;
+            }
+            if (wrote) {
+                output.flush();
+            }
+            if (stopping) {
+                break;
+            }
+            msleep(WriterIdleMs);
+        }
+    }
+
+    RecordQueue queue{QueueCapacity};
+    QFile output;
+    const Format format;
+    QAtomicInt stopRequested;
+    QAtomicInteger<quint64> droppedRecords;
+    int writeErrors = 0;
+};
+
+// Never deleted: producers on other threads may still hold on to it while
+// stop() runs.
+QAtomicPointer<Writer> writer;
+QElapsedTimer clock;
+
+} // namespace
+
+quint32 parseCategories(const QString &names, bool *ok)
+{
+    quint32 categories = 0;
+    bool valid = true;
+    for (const QString &name : names.split(QLatin1Char(','), QString::SkipEmptyParts)) {
+        const QString category = name.trimmed();
+        if (category == QLatin1String("details")) {
+            categories |= FontDetails;
+        } else if (category == QLatin1String("selection")) {
+            categories |= Selection;
+        } else if (category == QLatin1String("advances")) {
+            categories |= Advances;
+        } else if (category == QLatin1String("timing")) {
+            categories |= Timing;
+        } else if (category == QLatin1String("all")) {
+            categories |= AllCategories;
+        } else if (category != QLatin1String("none")) {
+            valid = false;
+        }
+    }
+    if (ok) {
+        *ok = valid;
+    }
+    return categories;
+}
+
+bool start(quint32 categories, Format format, const QString &output)
+{
+    stop();
+    Writer *newWriter = new Writer(format);
+    bool opened;
+    if (output.isEmpty() || output == QLatin1String("-")) {
+        opened = newWriter->output.open(stdout, QIODevice::WriteOnly);
+    } else {
+        newWriter->output.setFileName(output);
+        opened = newWriter->output.open(QIODevice::WriteOnly | QIODevice::Append);
+    }
+    if (!opened) {
+        delete newWriter;
+        return false;
+    }
+    if (!clock.isValid()) {
+        clock.start();
+    }
+    newWriter->start(QThread::LowPriority);
+    writer.storeRelease(newWriter);
+    enabledCategories.storeRelease(categories);
+    return true;
+}
+
+void stop()
+{
+    Writer *w = writer.fetchAndStoreAcquire(nullptr);
+    if (!w) {
+        return;
+    }
+    enabledCategories.storeRelease(0);
+    w->stopRequested.storeRelease(1);
+    w->wait();
+    if (w->droppedRecords.load() > 0) {
+        qWarning() << "Diagnostics: dropped" << w->droppedRecords.load() << "records, the buffer was full";
+    }
+    if (w->writeErrors > 0) {
+        qWarning() << "Diagnostics: could not write" << w->writeErrors << "records to" << w->output.fileName();
+    }
+    w->output.close();
+}
+
+quint64 dropped()
+{
+    Writer *w = writer.loadAcquire();
+    return w ? w->droppedRecords.load() : 0;
+}
+
+Record::Record(Category category, const char *event)
+    : d(new Data{category, event, clock.nsecsElapsed(), {}})
+{
+}
+
+Record::~Record()
+{
+    Writer *w = writer.loadAcquire();
+    if (w && w->queue.push(d)) {
+        if (writer.loadAcquire() != w) {
+            // stop() ran meanwhile, and its thread may have drained the
+            // queue and exited before the push; what is left is dropped
+            while (Record::Data *record = w->queue.pop()) {
+                w->droppedRecords.fetchAndAddRelaxed(1);
+                delete record;
+            }
+        }
+        return;
+    }
+    if (w) {
+        w->droppedRecords.fetchAndAddRelaxed(1);
+    }
+    delete d;
+}
+
+Record &Record::field(const char *key, const QVariant &value)
+{
+    d->fields.append(qMakePair(key, value));
+    return *this;
+}
+
+} // namespace Diagnostics
@@ -0,0 +1,101 @@
+/*!
+ *  @file diagnostics.h
+ *
+ *  Structured diagnostic records, collected in a lock-free ring buffer and
+ *  written by a background thread as text or JSON lines.
+ *
+ */
+
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <QAtomicInteger>
+#include <QPair>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+namespace Diagnostics {
+
+enum Category : quint32 {
+    FontDetails = 0x01,     ///< the QFontInfo/QFontMetrics reports of fontDetails()
+    Selection = 0x02,       ///< how a selected font is interpreted and restored
+    Advances = 0x04,        ///< glyph advances and bounding rects of the painted text
+    Timing = 0x08,          ///< font file load and registration times
+    AllCategories = 0x0f
+};
+
+enum Format {
+    TextFormat,
+    JsonFormat
+};
+
+// the enabled categories; read through isEnabled()
+extern QAtomicInteger<quint32> enabledCategories;
+
+inline bool isEnabled(Category category)
+{
+    return enabledCategories.load() & category;
+}
+
+/**
+ * Parses a comma-separated list of category names (details, selection,
+ * advances, timing, all or none).
+ * @return the categories, with @p ok set to false for unknown names
+ */
+quint32 parseCategories(const QString &names, bool *ok = nullptr);
+
+/**
+ * Enables @p categories and starts the thread that writes the records to
+ * @p output (empty or "-" for stdout).
+ * @return false if @p output cannot be opened
+ */
+bool start(quint32 categories, Format format, const QString &output = QString());
+
+/**
+ * Disables all categories, writes the records still in the buffer and
+ * stops the writer thread.
+ */
+void stop();
+
+/**
+ * @return the number of records dropped because the buffer was full
+ */
+quint64 dropped();
+
+/**
+ * One record, built field by field and handed to the writer when it goes
+ * out of scope. Use it through DIAG(), which skips the construction and
+ * the evaluation of the field values when the category is disabled:
+ *
+ * @code
+ * DIAG(Selection, "restored").field("font", font.toString()).field("exact", exact);
+ * @endcode
+ */
+class Record
+{
+public:
+    Record(Category category, const char *event);
+    ~Record();
+
+    /**
+     * @p key must be a string literal. Values are written as strings
+     * (QVariant::toString()) or, in JSON, as QJsonValue::fromVariant().
+     */
+    Record &field(const char *key, const QVariant &value);
+
+    // the record as it is queued for the writer
+    struct Data;
+
+private:
+    Q_DISABLE_COPY(Record)
+
+    Data *d;
+};
+
+} // namespace Diagnostics
+
+#define DIAG(category, event) \
+    if (!Diagnostics::isEnabled(Diagnostics::category)) {} else Diagnostics::Record(Diagnostics::category, event)
+
+#endif // DIAGNOSTICS_H
@@ -49,18 +49,28 @@
 
 #include "dialog.h"
 #include "timing.h"
+#include "benchmark.h"
+#include "fontweightmapper.h"
+#include "mappedfontfile.h"
+#include "settingswriter.h"
+#include "diagnostics.h"
+#include "fontreporter.h"
+#include "fontdescription.h"
+#include "storedfont.h"
 #include "kwidgetsaddons/kfontrequester.h"
+#include "kwidgetsaddons/fontcatalog_p.h"
 
 // #define QRAWFONT_FROM_DATA
 
-QFont stripStyleName(QFont &f, QFontDatabase &db)
+QFont stripStyleName(QFont &f)
 {
     const QString &styleName = f.styleName();
     if (styleName.isEmpty()) {
         return f;
     } else {
-        QFont g = (db.styleString(f) != styleName) ?
-            db.font(f.family(), styleName, f.pointSize())
+        const FontCatalog *db = FontCatalog::instance();
+        QFont g = (db->styleString(f) != styleName) ?
+            db->font(f.family(), styleName, f.pointSize())
             : QFont(f.family(), f.pointSize(), f.weight());
         if (auto s = f.pixelSize() > 0) {
             g.setPixelSize(s);
@@ -95,36 +105,33 @@ void benchmarkCloning(QFont &font)
         return;
     }
 
-    int N = 1000000, fact = 1;
-    int i;
     extern void doSomethingWithQFont(QFont&);
-    double overhead;
-    do {
-        N *= fact;
-        HRTime_tic();
-        QFont tmp(font);
-        for (i = 0 ; i < N ; ++i) {
+    // (re)register for the font that was just selected
+    const QFont selected(font);
+    Benchmark::registerBenchmark(QStringLiteral("cloning/stripStyleName"), [selected](quint64 iterations) {
+        QFont source(selected);
+        for (quint64 i = 0 ; i < iterations ; ++i) {
+            QFont tmp(stripStyleName(source));
             doSomethingWithQFont(tmp);
+            Benchmark::doNotOptimize(tmp);
         }
-        overhead = HRTime_toc();
-        qInfo() << "overhead=" << overhead;
-        fact = 2;
-    } while (overhead < 0.05);
-    QFontDatabase db;
-    HRTime_tic();
-    for (i = 0 ; i < N ; ++i) {
-        QFont tmp(stripStyleName(font, db));
-        doSomethingWithQFont(tmp);
-    }
-    double elapsed = HRTime_toc();
-    qWarning() << N << "times `QFont tmp=stripStyleName(font)`:" << elapsed - overhead << "seconds";
-    HRTime_tic();
-    for (i = 0 ; i < N ; ++i) {
-        QFont tmp(clone(font));
-        doSomethingWithQFont(tmp);
-    }
-    elapsed = HRTime_toc();
-    qWarning() << N << "times `QFont tmp(clone(font))`:" << elapsed - overhead << "seconds";
+    });
+    Benchmark::registerBenchmark(QStringLiteral("cloning/clone"), [selected](quint64 iterations) {
+        for (quint64 i = 0 ; i < iterations ; ++i) {
+            QFont tmp(clone(selected));
+            doSomethingWithQFont(tmp);
+            Benchmark::doNotOptimize(tmp);
+        }
+    });
+    Benchmark::registerBenchmark(QStringLiteral("cloning/copy+setBold"), [selected](quint64 iterations) {
+        for (quint64 i = 0 ; i < iterations ; ++i) {
+            QFont tmp(selected);
+            doSomethingWithQFont(tmp);
+            Benchmark::doNotOptimize(tmp);
+        }
+    });
+    qInfo() << "Benchmarking with" << font;
+    Benchmark::report(Benchmark::run(QStringLiteral("^cloning/")));
 }
 
 class DialogOptionsWidget : public QGroupBox
@@ -176,6 +183,23 @@ static QString fontRepr(QFont &font)
     return QString("%1,%2pt,w=%3,it=%4").arg(font.family()).arg(font.pointSize()).arg(font.weight()).arg(font.italic());
 }
 
+// what QFont::fromString() makes of the font's own toString(); this is one
+// of the round trips the tool checks, so it goes through Qt itself
+static QString fromStringRoundTrip(const QFont &font)
+{
+    QFont copy;
+    copy.fromString(font.toString());
+    return copy.toString();
+}
+
+// The settings writer builds the descriptor on its worker thread, and only
+// for the font it actually writes: StoredFont::fromFont() loads the font
+// and reads its tables.
+static QVariant fontDescriptor(const QVariant &font)
+{
+    return StoredFont::fromFont(font.value<QFont>()).data();
+}
+
 Dialog::Dialog(QWidget *parent)
     : QDialog(parent)
 {
@@ -183,6 +207,45 @@ Dialog::Dialog(QWidget *parent)
     // will be toggled by fontDetails()
     setWindowModified(true);
 
+    // every fontSelected() emission stores the font, even while scrolling
+    // through the chooser lists
+    settingsWriter = new SettingsWriter(250, this);
+
+    // the names used in the font reports
+    styleString[QFont::StyleNormal] = "normal";
+    styleString[QFont::StyleItalic] = "italic";
+    styleString[QFont::StyleOblique] = "oblique";
+    styleHintString[QFont::Helvetica] = "Helvetica";
+    styleHintString[QFont::SansSerif] = "SansSerif (Helvetica)";
+    styleHintString[QFont::Times] = "Times";
+    styleHintString[QFont::Serif] = "Serif (Times)";
+    styleHintString[QFont::Courier] = "Courier";
+    styleHintString[QFont::TypeWriter] = "TypeWriter (Courier)";
+    styleHintString[QFont::OldEnglish] = "OldEnglish";
+    styleHintString[QFont::Decorative] = "Decorative (OldEnglish)";
+    styleHintString[QFont::System] = "System";
+    styleHintString[QFont::AnyStyle] = "AnyStyle";
+    styleHintString[QFont::Cursive] = "Cursive";
+    styleHintString[QFont::Monospace] = "Monospace";
+    styleHintString[QFont::Fantasy] = "Fantasy";
+    // and asks for a font report, of which only the last one of a burst of
+    // selections is shown
+    fontReporter = new FontReporter(styleString, styleHintString, this);
+    extern bool doSyncFontDetails;
+    fontReporter->setSynchronous(doSyncFontDetails);
+    connect(qApp, &QCoreApplication::aboutToQuit, this, [this]() {
+        extern bool doBenchmark;
+        if (doBenchmark) {
+            qInfo() << "settings:" << settingsWriter->requests() << "values stored in" << settingsWriter->writes()
+                << "writes," << settingsWriter->coalesced() << "coalesced";
+            qInfo().noquote() << "font selection blocked the GUI for" << Benchmark::formatSeconds(Benchmark::median(selectionTimes))
+                << "(median of" << selectionTimes.size() << "selections) with the font reports computed"
+                << (fontReporter->isSynchronous() ? "on the GUI thread;" : "on a worker;")
+                << "reports arrived after" << Benchmark::formatSeconds(fontReporter->medianLatency())
+                << "(median)," << fontReporter->dropped() << "of" << fontReporter->requests() << "dropped as stale";
+        }
+    });
+
     qApp->setStyleSheet("QLabel{ background: white }");
     int frameStyle = QFrame::Sunken | QFrame::Panel;
     QSettings store;
@@ -198,29 +261,56 @@ Dialog::Dialog(QWidget *parent)
     fontLabel->setFrameStyle(frameStyle);
     fontLabel->setToolTip(tr("this shows what QFont::key() returns for the current font"));
     font = fontLabel->font();
+    // The legacy value is always read, in the format selected by
+    // storeNativeQFont, since restoring it is what the tool checks.
+    QFont legacyFont;
+    bool legacyRestored = false;
     if (prefFont != QVariant()) {
         if (storeNativeQFont) {
             if (prefFont.canConvert<QFont>()) {
-                font = prefFont.value<QFont>();
-                qWarning() << "Restoring saved native font" << font << "from" << prefFont;
-                fontDetails(font, stdout);
+                legacyFont = prefFont.value<QFont>();
+                DIAG(Selection, "restored").field("font", legacyFont.toString()).field("native", true);
+                legacyRestored = true;
             }
             else {
-                qWarning() << "Cannot restore font from" << prefFont;
+                DIAG(Selection, "restoreFailed").field("value", prefFont.toString()).field("native", true);
             }
         }
         else {
-            QFont fn;
-            if (!fn.fromString(prefFont.toString())) {
-                qWarning() << "Failed to restore font from" << prefFont << "toString=" << prefFont.toString();
+            if (!FontDescription::fromString(prefFont.toString(), &legacyFont)) {
+                DIAG(Selection, "restoreFailed").field("value", prefFont.toString()).field("native", false);
             }
             else {
-                qWarning() << "Restoring saved font" << fn;
-                fontDetails(fn, stdout);
-                font = fn;
+                DIAG(Selection, "restored").field("font", legacyFont.toString()).field("native", false);
+                legacyRestored = true;
             }
         }
     }
+    const StoredFont storedFont = StoredFont::fromData(store.value("fontDescriptor").toByteArray());
+    if (storedFont.isValid()) {
+        bool faceChanged;
+        font = storedFont.toFont(&faceChanged);
+        DIAG(Selection, "restored")
+            .field("font", font.toString())
+            .field("descriptor", true)
+            .field("postScriptName", storedFont.postScriptName().toString())
+            .field("faceChanged", faceChanged);
+        if (legacyRestored) {
+            DIAG(Selection, "restoreCompared")
+                .field("descriptor", font.toString())
+                .field("legacy", legacyFont.toString())
+                .field("native", storeNativeQFont)
+                .field("agree", font.toString() == legacyFont.toString());
+        }
+        fontDetails(font);
+    }
+    else if (legacyRestored) {
+        // settings from before the descriptor
+        font = legacyFont;
+        settingsWriter->setValue("fontDescriptor", font, fontDescriptor);
+        DIAG(Selection, "migrated").field("font", font.toString()).field("native", storeNativeQFont);
+        fontDetails(font);
+    }
     fontLabel->setFont(font);
     fontLabel->setText(font.key());
     QPushButton *fontButton = new QPushButton(tr("QFontDialog::get&Font()"));
@@ -241,8 +331,8 @@ Dialog::Dialog(QWidget *parent)
     fontPreview->setFrameStyle(frameStyle);
     fontPreview->setToolTip(tr("this shows current font family, QFont::styleString() and decimal point size"));
     fontPreview->setFont(font);
-    QFontDatabase db;
-    fontPreview->setText( font.family() + tr(" ") + db.styleString(font) + tr(" @ ") + QString("%1pt").arg(font.pointSizeF()) );
+    const FontCatalog *db = FontCatalog::instance();
+    fontPreview->setText( font.family() + tr(" ") + db->styleString(font) + tr(" @ ") + QString("%1pt").arg(font.pointSizeF()) );
 
     clonedFontPreview = new QLabel;
     clonedFontPreview->setFrameStyle(frameStyle);
@@ -250,8 +340,7 @@ Dialog::Dialog(QWidget *parent)
     clonedBoldFontPreview = new QLabel;
     clonedBoldFontPreview->setFrameStyle(frameStyle);
     clonedBoldFontPreview->setToolTip(tr("this shows the font cloned without styleName and made bold"));
-    {   QFontDatabase db;
-        QFont tmp = stripStyleName(font, db);
+    {   QFont tmp = stripStyleName(font);
         clonedFontPreview->setFont(tmp);
         tmp.setBold(true);
         clonedBoldFontPreview->setFont(tmp);
@@ -377,22 +466,6 @@ Dialog::Dialog(QWidget *parent)
              << "QFont::Bold=" << QFont::Bold
              << "QFont::Black=" << QFont::Black;
 #endif
-    styleString[QFont::StyleNormal] = "normal";
-    styleString[QFont::StyleItalic] = "italic";
-    styleString[QFont::StyleOblique] = "oblique";
-    styleHintString[QFont::Helvetica] = "Helvetica";
-    styleHintString[QFont::SansSerif] = "SansSerif (Helvetica)";
-    styleHintString[QFont::Times] = "Times";
-    styleHintString[QFont::Serif] = "Serif (Times)";
-    styleHintString[QFont::Courier] = "Courier";
-    styleHintString[QFont::TypeWriter] = "TypeWriter (Courier)";
-    styleHintString[QFont::OldEnglish] = "OldEnglish";
-    styleHintString[QFont::Decorative] = "Decorative (OldEnglish)";
-    styleHintString[QFont::System] = "System";
-    styleHintString[QFont::AnyStyle] = "AnyStyle";
-    styleHintString[QFont::Cursive] = "Cursive";
-    styleHintString[QFont::Monospace] = "Monospace";
-    styleHintString[QFont::Fantasy] = "Fantasy";
 
     QFont::insertSubstitution(QStringLiteral("Helvetica"), QStringLiteral("Helvetica Neue"));
     qWarning() << "Current substitutions:";
@@ -465,75 +538,47 @@ Dialog::Dialog(QWidget *parent)
 //         ascent, descent: 11,3; average width=6
 //         height, x-height, max.width: 14,5,14; natural line spacing: -1
 
-QFont Dialog::fontDetails(QFont &font, QTextStream &sink)
+void Dialog::fontDetails(const QFont &font, const FontReporter::Callback &onArrival)
 {
-    QFont ret = font;
-    QFontInfo fi(font);
-    setWindowModified(!isWindowModified());
-    setWindowFilePath(QString());
-    setWindowTitle(fi.family() + " [*]");
-    sink << "QFontInfo for " << font.toString() << (fi.exactMatch()? " (exact match):" : " :") << endl;
-    sink << "\tfamily " << fi.family() << " styleName=" << fi.styleName() << ", style=" << styleString[fi.style()]
-        << (fi.bold()? " bold " : " ")
-        << fi.pointSizeF() << "pt; " << fi.pixelSize() << "px; weight " << fi.weight() << "\n\t"
-        << "stretch: " << font.stretch() << "; l.spacing:" << font.letterSpacing()
-        << " type: " << font.letterSpacingType() << endl;
-    sink << "\tstyleHint: " << styleHintString[fi.styleHint()] << (fi.fixedPitch()? ", fixed pitch" : "") << endl;
-    QFontDatabase db;
-    sink << "\tQFontDatabase::styleString() = " << db.styleString(font) << endl;
-    if (!font.styleName().isEmpty()) {
-        ret = db.font(font.family(), font.styleName(), font.pointSize());
-        sink << "\tQFontDatabase::font(" << font.family() << "," << font.styleName() << "," << font.pointSize() << ") = "
-            << ret.toString() << endl;
-    }
-    QFontMetrics fm(font);
-    sink << "QFontMetrics:" << endl;
-    sink << "\tleading, ascent, descent: " << fm.leading() << "," << fm.ascent() << "," << fm.descent()
-        << "; bearings: " << fm.minLeftBearing() << "," << fm.minRightBearing()
-        << "; average width=" << fm.averageCharWidth() << endl;
-    sink << "\theight, x-height, max.width: " << fm.height() << "," << fm.xHeight() << "," << fm.maxWidth()
-        << "; natural line spacing: " << fm.leading() << endl;
-    return ret;
-}
-
-QString Dialog::fontDetails(QFont &font)
-{
-    QString details;
-    QTextStream sink(&details);
-    fontDetails(font, sink);
-    return details;
-}
-
-QFont Dialog::fontDetails(QFont &font, FILE *fp)
-{
-    QTextStream sink(fp);
-    return fontDetails(font, sink);
+    fontReporter->request(font, [this, onArrival](const FontReport &report) {
+        setWindowModified(!isWindowModified());
+        setWindowFilePath(QString());
+        setWindowTitle(report.family + " [*]");
+        if (onArrival) {
+            onArrival(report);
+        }
+    });
 }
 
-QFont Dialog::fontDetails(QRawFont &font, QTextStream &sink)
+QFont Dialog::fontDetails(QRawFont &font)
 {
     QFont ret;
     setWindowModified(!isWindowModified());
     setWindowTitle(font.familyName() + " [*]");
-    sink << "QRawFontInfo:" << endl;
-    sink << "\tfamily " << font.familyName() << " styleName=" << font.styleName() << ", style=" << styleString[font.style()]
-        << " " << font.pixelSize() << "px; weight " << font.weight() << "\n\t" << endl;
-    QFontDatabase db;
     if (!font.styleName().isEmpty()) {
-        ret = db.font(font.familyName(), font.styleName(), font.pixelSize());
-        sink << "\tQFontDatabase::font(" << font.familyName() << "," << font.styleName() << "," << font.pixelSize() << ") = "
-            << ret.toString() << endl;
+        ret = FontCatalog::instance()->font(font.familyName(), font.styleName(), font.pixelSize());
     }
-    sink << "QRawFontMetrics:" << endl;
-    sink << "\tleading, ascent, descent: " << font.leading() << "," << font.ascent() << "," << font.descent()
-        << "; average width=" << font.averageCharWidth() << endl;
-    sink << "\tcapHeight, x-height, max.Charwidth: " << font.capHeight() << "," << font.xHeight() << "," << font.maxCharWidth()
-        << "; natural line spacing: " << font.leading() << endl;
+    DIAG(FontDetails, "rawFont")
+        .field("family", font.familyName())
+        .field("styleName", font.styleName())
+        .field("style", styleString[font.style()])
+        .field("pixelSize", font.pixelSize())
+        .field("weight", font.weight())
+        .field("databaseFont", font.styleName().isEmpty() ? QVariant() : QVariant(ret.toString()))
+        .field("leading", font.leading())
+        .field("ascent", font.ascent())
+        .field("descent", font.descent())
+        .field("averageCharWidth", font.averageCharWidth())
+        .field("capHeight", font.capHeight())
+        .field("xHeight", font.xHeight())
+        .field("maxCharWidth", font.maxCharWidth());
     return ret;
 }
 
 void Dialog::setFont(const QFont &fnt)
 {
+    // how long a selection keeps the GUI busy, with --benchmark
+    HRTime_tic();
     font = fnt;
     fontLabel->setText(font.key());
     fontLabel->setFont(font);
@@ -541,12 +586,11 @@ void Dialog::setFont(const QFont &fnt)
     fontLabel2->setFont(font);
     fontStyleName->setText(font.styleName());
     fontStyleName->setFont(font);
-    QFontDatabase db;
+    const FontCatalog *db = FontCatalog::instance();
     fontPreview->setFont(font);
-    fontPreview->setText( font.family() + tr(" ") + db.styleString(font) + tr(" @ ") + QString("%1pt").arg(font.pointSizeF()) );
+    fontPreview->setText( font.family() + tr(" ") + db->styleString(font) + tr(" @ ") + QString("%1pt").arg(font.pointSizeF()) );
 
-    {   QFontDatabase db;
-        QFont tmp = stripStyleName(font, db);
+    {   QFont tmp = stripStyleName(font);
         clonedFontPreview->setFont(tmp);
         tmp.setBold(true);
         clonedBoldFontPreview->setFont(tmp);
@@ -554,18 +598,13 @@ void Dialog::setFont(const QFont &fnt)
     clonedFontPreview->setText(clonedFontPreview->font().key());
     clonedBoldFontPreview->setText(clonedBoldFontPreview->font().key());
 
-    qWarning() << "QFontDatabase::styleString for this typeface:" << db.styleString(font);
-    qWarning() << "font.key():" << font.key();
-    QFont dum;
-    dum.fromString(font.toString());
-    qWarning() << "QFont::fromString(" << font.toString() << ")" << dum;
-    fontDetails(font, stdout);
-    if (storeNativeQFont) {
-        QSettings().setValue("font", font);
-    }
-    else{
-        QSettings().setValue("font", font.toString());
-    }
+    DIAG(Selection, "selected")
+        .field("font", font.toString())
+        .field("key", font.key())
+        .field("styleString", db->styleString(font))
+        .field("fromString", fromStringRoundTrip(font));
+    fontDetails(font);
+    storeFont(font);
     fontLabel->update();
     setPaintFont(font);
     fontStretch->setValue(QFont::Unstretched);
@@ -574,6 +613,11 @@ void Dialog::setFont(const QFont &fnt)
         fontRequester->setFont(font);
     }
     fontRequester->setSampleText(fontRequester->font().key());
+    const double selectionTime = HRTime_toc();
+    extern bool doBenchmark;
+    if (doBenchmark) {
+        selectionTimes.append(selectionTime);
+    }
 }
 
 void Dialog::setFont()
@@ -586,7 +630,7 @@ void Dialog::setFont()
 //         fontLabel->setFont(font);
 //     }
     bool ok;
-    qWarning() << "Preselecting font=" << font;
+    DIAG(Selection, "preselect").field("font", font.toString());
     QFont fnt = QFontDialog::getFont(&ok, font, this, "Select Font", options);
     if (ok) {
         setFont(fnt);
@@ -598,10 +642,15 @@ void Dialog::setFontFromSpecs()
 {
     const QFontDialog::FontDialogOptions options = QFlag(fontDialogOptionsWidget->value());
     bool ok;
-    qWarning() << "Preselecting font.key=" << fontLabel2->text() << "(font=" << font << ")";
     QFont font2 = QFont(font.family(), font.pointSize(), font.weight(), font.italic());
-    qWarning() << "QFont:family=" << font.family() << "weight=" << font.weight() << font.styleName() << "italic=" << font.italic() << "=" << font2;
-    qWarning() << "Preselecting font.key=" << fontLabel2->text() << "(font=" << font << "=>" << font2 << ")";
+    DIAG(Selection, "preselectSpecs")
+        .field("label", fontLabel2->text())
+        .field("font", font.toString())
+        .field("family", font.family())
+        .field("weight", font.weight())
+        .field("styleName", font.styleName())
+        .field("italic", font.italic())
+        .field("specs", font2.toString());
     font2 = QFontDialog::getFont(&ok, font2, this, "Select Font", options);
     if (ok) {
         fontLabel2->setText(fontRepr(font2));
@@ -610,14 +659,16 @@ void Dialog::setFontFromSpecs()
         fontLabel->setFont(font2);
         fontStyleName->setText(font2.styleName());
         fontStyleName->setFont(font2);
-        qWarning() << "Selected font" << font2 << "which" << ((font == font2)? "is" : "is not") << "equal to the previous font" << font;
+        DIAG(Selection, "selectedSpecs")
+            .field("font", font2.toString())
+            .field("previous", font.toString())
+            .field("equal", font == font2);
         font = font2;
-        QFontDatabase db;
+        const FontCatalog *db = FontCatalog::instance();
         fontPreview->setFont(font);
-        fontPreview->setText( font.family() + tr(" ") + db.styleString(font) + tr(" @ ") + QString("%1pt").arg(font.pointSizeF()) );
+        fontPreview->setText( font.family() + tr(" ") + db->styleString(font) + tr(" @ ") + QString("%1pt").arg(font.pointSizeF()) );
 
-        {   QFontDatabase db;
-            QFont tmp = stripStyleName(font2, db);
+        {   QFont tmp = stripStyleName(font2);
             clonedFontPreview->setFont(tmp);
             tmp.setBold(true);
             clonedBoldFontPreview->setFont(tmp);
@@ -625,19 +676,13 @@ void Dialog::setFontFromSpecs()
         clonedFontPreview->setText(clonedFontPreview->font().key());
         clonedBoldFontPreview->setText(clonedBoldFontPreview->font().key());
 
-        qWarning() << "QFontDatabase::styleString for this typeface:" << db.styleString(font);
-        qWarning() << "font.key():" << font.key();
-        QFont dum;
-        dum.fromString(font.toString());
-        qWarning() << "QFont::fromString(" << font.toString() << ")" << dum;
-        fontDetails(font, stdout);
-        QSettings store;
-        if (storeNativeQFont) {
-            store.setValue("font", font);
-        }
-        else{
-            store.setValue("font", font.toString());
-        }
+        DIAG(Selection, "selected")
+            .field("font", font.toString())
+            .field("key", font.key())
+            .field("styleString", db->styleString(font))
+            .field("fromString", fromStringRoundTrip(font));
+        fontDetails(font);
+        storeFont(font);
 //         store.sync();
 //         qWarning() << "Font QSetting" << store.allKeys() << "status:" << store.status();
 //         qWarning() << "settings(\"font\")=" << store.value("font") << "canConvert<QFont>:" << store.value("font").canConvert<QFont>();
@@ -650,18 +695,27 @@ void Dialog::setFontFromSpecs()
     }
 }
 
-void Dialog::setFontStoreType()
+void Dialog::storeFont(const QFont &font)
 {
-    storeNativeQFont = !fontStoreTypeSel->isChecked();
-    QSettings store;
-    store.setValue("storeNativeQFont", storeNativeQFont);
+    // the descriptor is what the font is restored from; "font" is kept in
+    // the selected format and compared with it on startup
     if (storeNativeQFont) {
-        store.setValue("font", font);
+        settingsWriter->setValue("font", font);
     }
     else{
-        store.setValue("font", font.toString());
+        settingsWriter->setValue("font", FontDescription::toString(font));
     }
-    store.sync();
+    settingsWriter->setValue("fontDescriptor", font, fontDescriptor);
+}
+
+void Dialog::setFontStoreType()
+{
+    storeNativeQFont = !fontStoreTypeSel->isChecked();
+    settingsWriter->setValue("storeNativeQFont", storeNativeQFont);
+    storeFont(font);
+    // read back what was actually written
+    settingsWriter->flush();
+    QSettings store;
     qWarning() << "Font QSetting" << store.allKeys() << "status:" << store.status();
     qWarning() << "settings(\"font\")=" << store.value("font") << "canConvert<QFont>:" << store.value("font").canConvert<QFont>();
 }
@@ -676,11 +730,13 @@ void Dialog::getFontFromFamily()
 //         famFont.setStyleStrategy(QFont::ForceOutline);
         famFont.setFamily(text);
         fontFamilyPreview->setFont(famFont);
-        fontFamilyPreview->setText(text + QLatin1String(" -> ") + famFont.toString()
-            + QLatin1String(" = ") + QFontInfo(famFont).family());
-        fontFamilyPreview->update();
+        fontFamilyPreview->setText(text + QLatin1String(" -> ") + famFont.toString());
         setPaintFont(famFont);
-        fontDetails(famFont, stdout);
+        // the family actually used comes with the report
+        const QString label = fontFamilyPreview->text();
+        fontDetails(famFont, [this, label](const FontReport &report) {
+            fontFamilyPreview->setText(label + QLatin1String(" = ") + report.family);
+        });
     }
 }
 
@@ -701,22 +757,33 @@ void Dialog::getFontFromFile()
             QString fName = fDialog->selectedFiles().at(0);
             QFileInfo fi(fName);
             startDir = fi.absoluteDir().path();
+            HRTime_tic();
 #ifdef QRAWFONT_FROM_DATA
-            QFile f(fName);
-            f.open(QIODevice::ReadOnly);
-            QByteArray fontData = f.readAll();
-            f.close();
+            // one read-only mapping shared by QRawFont and the application font database
+            bool mapped;
+            const QByteArray fontData = MappedFontFile::data(fName, &mapped);
             QRawFont rFont(fontData, pointSize, QFont::PreferFullHinting);
 #else
             QRawFont rFont(fName, pointSize, QFont::PreferFullHinting);
 #endif
+            const double loadTime = HRTime_toc();
             if (rFont.isValid()) {
-                qWarning() << "Read font from" << fName;
                 rawFont = rFont;
 #ifdef QRAWFONT_FROM_DATA
-                qWarning() << "addApplicationFontFromData() returns:" << QFontDatabase::addApplicationFontFromData(fontData);
+                DIAG(Timing, "loadFont")
+                    .field("file", fName).field("bytes", fontData.size())
+                    .field("mapped", mapped).field("seconds", loadTime);
+                HRTime_tic();
+                const int id = FontCatalog::addApplicationFontFromData(fontData);
+                const double addTime = HRTime_toc();
+                DIAG(Timing, "addApplicationFontFromData").field("id", id).field("seconds", addTime);
 #else
-                qWarning() << "addApplicationFont() returns:" << QFontDatabase::addApplicationFont(fName);
+                DIAG(Timing, "loadFont")
+                    .field("file", fName).field("bytes", fi.size()).field("seconds", loadTime);
+                HRTime_tic();
+                const int id = FontCatalog::addApplicationFont(fName);
+                const double addTime = HRTime_toc();
+                DIAG(Timing, "addApplicationFont").field("id", id).field("seconds", addTime);
 #endif
             } else {
                 qWarning() << fName << "doesn't give a valid font";
@@ -730,10 +797,9 @@ void Dialog::getFontFromFile()
         rawFont.setPixelSize(pointSize);
         const QString label = QStringLiteral("%1 %2 @ %3pt")\
             .arg(rawFont.familyName()).arg(rawFont.styleName()).arg(pointSize);
-        qWarning() << "Raw font:" << label;
+        DIAG(Selection, "rawFont").field("label", label);
         setPaintFont(rawFont, label);
-        QTextStream sink(stdout);
-        fontDetails(rawFont, sink);
+        fontDetails(rawFont);
     }
 }
 
@@ -744,11 +810,10 @@ void Dialog::setFontStyleName()
                                          tr("Font styleName:"), QLineEdit::Normal,
                                          font.styleName(), &ok);
     QFont fnt(font);
-    QFontDatabase fdb;
     if (!ok || text.isEmpty()) {
         fnt.setStyleName(QString());
         qWarning() << "Stripping via setStyleName(QString());" << font << "->" << fnt;
-        fnt = stripStyleName(font, fdb);
+        fnt = stripStyleName(font);
         qWarning() << "\tvia stripStyleName():" << fnt;
     } else {
         fnt.setStyleName(text);
@@ -757,37 +822,111 @@ void Dialog::setFontStyleName()
     styledFontPreview->setText(fnt.key());
     fontRequester->setFont(fnt);
     fontRequester->setSampleText(fontRequester->font().key());
-    fnt = fontDetails(fnt, stdout);
-    styledFontPreview->setToolTip(tr(STYLEDFNTPREVIEWTT).arg(fnt.toString()));
-    QFont boldFnt(fnt);
-    boldFnt.setStyleName(QString());
-    boldFnt.setBold(true);
-    qWarning() << "style name emptied, font boldened:" << boldFnt.toString();
-    QFont stripped = stripStyleName(fnt, fdb);
-    qWarning() << "stripStyleName() gives" << stripped.toString();
-    stripped.setBold(true);
-    qWarning() << "\tboldened:" << stripped.toString();
+    fontDetails(fnt, [this](const FontReport &report) {
+        QFont dbFnt = report.databaseFont;
+        styledFontPreview->setToolTip(tr(STYLEDFNTPREVIEWTT).arg(dbFnt.toString()));
+        QFont boldFnt(dbFnt);
+        boldFnt.setStyleName(QString());
+        boldFnt.setBold(true);
+        qWarning() << "style name emptied, font boldened:" << boldFnt.toString();
+        QFont stripped = stripStyleName(dbFnt);
+        qWarning() << "stripStyleName() gives" << stripped.toString();
+        stripped.setBold(true);
+        qWarning() << "\tboldened:" << stripped.toString();
+    });
+}
+
+namespace {
+
+// Identifies a laid-out text. QRawFont has no public identity and every
+// setPixelSize() creates a new font engine, so describe the face by its
+// names, its style, its hinting and its 'head' table (checksum, dates).
+struct GlyphRunKey {
+    QString family;
+    QString styleName;
+    int weight;
+    int style;
+    int hinting;
+    QByteArray head;
+    qreal pixelSize;
+    QString text;
+
+    GlyphRunKey(const QRawFont &font, const QString &text)
+        : family(font.familyName())
+        , styleName(font.styleName())
+        , weight(font.weight())
+        , style(font.style())
+        , hinting(font.hintingPreference())
+        , head(font.fontTable("head"))
+        , pixelSize(font.pixelSize())
+        , text(text)
+    {}
+
+    bool operator==(const GlyphRunKey &other) const
+    {
+        return pixelSize == other.pixelSize && weight == other.weight && style == other.style
+            && hinting == other.hinting && text == other.text && family == other.family
+            && styleName == other.styleName && head == other.head;
+    }
+};
+
+inline uint qHash(const GlyphRunKey &key, uint seed = 0)
+{
+    return qHash(key.family, seed) ^ qHash(key.styleName) ^ qHash(key.text)
+        ^ qHash(key.head) ^ qHash(key.pixelSize) ^ uint(key.weight << 8 | key.style << 2 | key.hinting);
 }
 
+// The glyph runs of the most recently laid-out texts; enough for the whole
+// range of the size spinner, for a few fonts. The runs hold on to their font
+// engines, which must be released before the application is torn down.
+QCache<GlyphRunKey, QList<QGlyphRun> > &glyphRunCache()
+{
+    static QCache<GlyphRunKey, QList<QGlyphRun> > cache(1024);
+    static bool connected = false;
+    if (!connected) {
+        QObject::connect(qApp, &QCoreApplication::aboutToQuit, [] { cache.clear(); });
+        connected = true;
+    }
+    return cache;
+}
+
+} // namespace
+
 void Dialog::setPaintFont(const QRawFont &rFont, const QString &text)
 {
     rawFont = rFont;
 
-    const auto glIdx = rawFont.glyphIndexesForString(text);
-    const auto advances = rawFont.advancesForGlyphIndexes(glIdx, QRawFont::SeparateAdvances);
-    qWarning() << text << "advances=" << advances;
-
-    QTextLayout layout(text);
-    layout.setRawFont(rFont);
-    layout.beginLayout();
-    QTextLine line = layout.createLine();
-    line.setLineWidth(INT_MAX/256);
-    layout.endLayout();
+    if (Diagnostics::isEnabled(Diagnostics::Advances)) {
+        const auto glIdx = rawFont.glyphIndexesForString(text);
+        const auto advances = rawFont.advancesForGlyphIndexes(glIdx, QRawFont::SeparateAdvances);
+        QVariantList xAdvances;
+        for (const QPointF &advance : advances) {
+            xAdvances.append(advance.x());
+        }
+        DIAG(Advances, "advances").field("text", text).field("advances", xAdvances);
+    }
 
-    glyphRuns = line.glyphRuns();
-    qWarning() << "Bounding rect(s):";
-    foreach (const auto glyph, glyphRuns) {
-        qWarning() << glyph.boundingRect();
+    const GlyphRunKey key(rFont, text);
+    if (const QList<QGlyphRun> *cached = glyphRunCache().object(key)) {
+        glyphRuns = *cached;
+    } else {
+        QTextLayout layout(text);
+        layout.setRawFont(rFont);
+        layout.beginLayout();
+        QTextLine line = layout.createLine();
+        line.setLineWidth(INT_MAX/256);
+        layout.endLayout();
+
+        glyphRuns = line.glyphRuns();
+        glyphRunCache().insert(key, new QList<QGlyphRun>(glyphRuns));
+    }
+    if (Diagnostics::isEnabled(Diagnostics::Advances)) {
+        for (const QGlyphRun &glyph : glyphRuns) {
+            const QRectF rect = glyph.boundingRect();
+            DIAG(Advances, "boundingRect")
+                .field("x", rect.x()).field("y", rect.y())
+                .field("width", rect.width()).field("height", rect.height());
+        }
     }
     paintLabel->setFixedHeight(rawFont.ascent() + rawFont.descent() + 4);
     paintLabel->update();
@@ -814,7 +953,7 @@ void Dialog::applyStretch()
     }
     stretchedFontPreview->setFont(fnt);
     stretchedFontPreview->setText(fnt.key());
-    fnt = fontDetails(fnt, stdout);
+    fontDetails(fnt);
 }
 
 void Dialog::paintEvent(QPaintEvent *)
@@ -46,6 +46,9 @@
 #include <QMap>
 #include <QList>
 #include <QGlyphRun>
+#include <QVector>
+
+#include "fontreporter.h"
 
 QT_BEGIN_NAMESPACE
 class QCheckBox;
@@ -56,8 +59,8 @@ class QSpinBox;
 QT_END_NAMESPACE
 
 class DialogOptionsWidget;
-class QTextStream;
 class KFontRequester;
+class SettingsWriter;
 
 class Dialog : public QDialog
 {
@@ -91,10 +94,9 @@ private:
     bool storeNativeQFont;
     QMap<QFont::Style, QString> styleString;
     QMap<QFont::StyleHint, QString> styleHintString;
-    QFont fontDetails(QFont &font, QTextStream &sink);
-    QString fontDetails(QFont &font);
-    QFont fontDetails(QFont &font, FILE *fp);
-    QFont fontDetails(QRawFont &font, QTextStream &sink);
+    void fontDetails(const QFont &font, const FontReporter::Callback &onArrival = FontReporter::Callback());
+    QFont fontDetails(QRawFont &font);
+    void storeFont(const QFont &font);
 
     QRawFont rawFont;
     QSpinBox *rawFontSize, *fontStretch;
@@ -102,6 +104,9 @@ private:
     QList<QGlyphRun> glyphRuns;
 
     KFontRequester *fontRequester;
+    SettingsWriter *settingsWriter;
+    FontReporter *fontReporter;
+    QVector<double> selectionTimes;
 };
 
 #endif
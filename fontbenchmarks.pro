@@ -0,0 +1,19 @@
+QT += gui core-private gui-private
+!greaterThan(QT_MAJOR_VERSION, 5):lessThan(QT_MINOR_VERSION, 10) {
+    error("Qt 5.10 or newer is required")
+}
+CONFIG += release c++11 rpath console
+CONFIG -= app_bundle
+QMAKE_CXXFLAGS_RELEASE -= -pipe -O2
+QMAKE_CXXFLAGS_RELEASE += -g -O3 -march=native
+
+TARGET        = fontbenchmarks
+HEADERS       = timing.c timing.h \
+                benchmark.h \
+                fontdescription.h \
+                kwidgetsaddons/fontcatalog_p.h
+SOURCES       = benchmarks_main.cpp \
+                benchmark.cpp \
+                fontdescription.cpp \
+                kwidgetsaddons/fontcatalog.cpp \
+                kwidgetsaddons/fontcatalogcache.cpp
@@ -0,0 +1,260 @@
+/*!
+ *  @file fontdescription.cpp
+ *
+ *  Parses and writes the comma-separated font descriptions of
+ *  QFont::toString() and QFont::fromString() without heap allocations.
+ *
+ */
+
+#include "fontdescription.h"
+
+#include <QLocale>
+
+#include <QtGui/private/qfont_p.h>
+
+#include <clocale>
+#include <cstdio>
+
+namespace {
+
+// QString::toInt() and toDouble() parse in the C locale and reject group
+// separators; QLocale::c() parses a QStringView in the same way, into a
+// buffer on the stack.
+const QLocale &cLocale()
+{
+    static const QLocale locale = []() {
+        QLocale c = QLocale::c();
+        c.setNumberOptions(QLocale::RejectGroupSeparator);
+        return c;
+    }();
+    return locale;
+}
+
+inline int toInt(QStringView field)
+{
+    return cLocale().toInt(field);
+}
+
+inline double toDouble(QStringView field)
+{
+    return cLocale().toDouble(field);
+}
+
+class Writer
+{
+public:
+    Writer(QChar *buffer, int size)
+        : buffer(buffer)
+        , size(size)
+    {}
+
+    void append(QChar c)
+    {
+        if (length < size) {
+            buffer[length] = c;
+        }
+        length += 1;
+    }
+
+    void append(QStringView text)
+    {
+        for (QChar c : text) {
+            append(c);
+        }
+    }
+
+    void appendLatin1(const char *text)
+    {
+        for (; *text; ++text) {
+            append(QLatin1Char(*text));
+        }
+    }
+
+    void appendNumber(int value)
+    {
+        char digits[16];
+        std::snprintf(digits, sizeof(digits), "%d", value);
+        appendLatin1(digits);
+    }
+
+    // QString::number(value), that is the 'g' format with 6 significant
+    // digits and a two-digit exponent, which is what %.6g writes too, but
+    // with the decimal point of the C library's locale.
+    void appendNumber(double value)
+    {
+        char digits[32];
+        std::snprintf(digits, sizeof(digits), "%.6g", value);
+        const char point = *std::localeconv()->decimal_point;
+        for (char *c = digits; *c; ++c) {
+            if (*c == point) {
+                *c = '.';
+            }
+        }
+        appendLatin1(digits);
+    }
+
+    QChar *const buffer;
+    const int size;
+    int length = 0;
+};
+
+} // namespace
+
+bool FontDescription::parse(QStringView text)
+{
+    text = text.trimmed();
+
+    // QStringRef::split() in QFont::fromString() keeps the empty fields
+    enum { MaxFields = 11 };
+    QStringView field[MaxFields];
+    int count = 0;
+    int start = 0;
+    for (int i = 0; i <= text.size(); ++i) {
+        if (i == text.size() || text.at(i) == QLatin1Char(',')) {
+            if (count == MaxFields) {
+                return false;
+            }
+            field[count++] = text.mid(start, i - start);
+            start = i + 1;
+        }
+    }
+    if ((count > 2 && count < 9) || field[0].isEmpty()) {
+        return false;
+    }
+
+    FontDescription d;
+    d.fields = count;
+    d.family = field[0];
+    if (count > 1) {
+        d.pointSize = toDouble(field[1]);
+    }
+    if (count == 9) {
+        d.styleHint = toInt(field[2]);
+        d.weight = toInt(field[3]);
+        d.style = toInt(field[4]) ? QFont::StyleItalic : QFont::StyleNormal;
+        d.underline = toInt(field[5]);
+        d.strikeOut = toInt(field[6]);
+        d.fixedPitch = toInt(field[7]);
+    } else if (count >= 10) {
+        d.pixelSize = toInt(field[2]);
+        d.styleHint = toInt(field[3]);
+        d.weight = toInt(field[4]);
+        d.style = toInt(field[5]);
+        d.underline = toInt(field[6]);
+        d.strikeOut = toInt(field[7]);
+        d.fixedPitch = toInt(field[8]);
+        if (count == 11) {
+            d.styleName = field[10];
+        }
+    }
+    *this = d;
+    return true;
+}
+
+void FontDescription::applyTo(QFont *font) const
+{
+    if (fields == 0) {
+        return;
+    }
+    font->setFamily(family.toString());
+    if (fields > 1 && pointSize > 0) {
+        font->setPointSizeF(pointSize);
+    }
+    if (fields >= 9) {
+        if (fields >= 10 && pixelSize > 0) {
+            font->setPixelSize(pixelSize);
+        }
+        font->setStyleHint(QFont::StyleHint(styleHint));
+        font->setWeight(qMax(qMin(99, weight), 0));
+        font->setStyle(QFont::Style(style));
+        font->setUnderline(underline);
+        font->setStrikeOut(strikeOut);
+        font->setFixedPitch(fixedPitch);
+
+        // QFont::fromString() sets these without marking them as resolved,
+        // which no public setter does
+        if (QFontPrivate::get(*font)->ref.load() != 1) {
+            // the setters above all found their values in place; toggling
+            // one that is resolved already detaches without other effects
+            font->setUnderline(!underline);
+            font->setUnderline(underline);
+        }
+        QFontPrivate *d = QFontPrivate::get(*font);
+        if (fields >= 10) {
+            d->request.styleName = styleName.toString();
+        }
+        if (!fixedPitch) {
+            d->request.ignorePitch = true;
+        }
+    }
+}
+
+int FontDescription::format(QChar *buffer, int size) const
+{
+    Writer out(buffer, size);
+    out.append(family);
+    out.append(QLatin1Char(','));
+    out.appendNumber(double(pointSize));
+    out.append(QLatin1Char(','));
+    out.appendNumber(pixelSize);
+    out.append(QLatin1Char(','));
+    out.appendNumber(styleHint);
+    out.append(QLatin1Char(','));
+    out.appendNumber(weight);
+    out.append(QLatin1Char(','));
+    out.appendNumber(style);
+    out.append(QLatin1Char(','));
+    out.appendNumber(int(underline));
+    out.append(QLatin1Char(','));
+    out.appendNumber(int(strikeOut));
+    out.append(QLatin1Char(','));
+    out.appendNumber(int(fixedPitch));
+    // the raw mode flag, which Qt 5 always writes as 0
+    out.appendLatin1(",0");
+    if (!styleName.isEmpty()) {
+        out.append(QLatin1Char(','));
+        out.append(styleName);
+    }
+    return out.length;
+}
+
+QString FontDescription::toString() const
+{
+    QString text(format(nullptr, 0), Qt::Uninitialized);
+    format(text.data(), text.size());
+    return text;
+}
+
+FontDescription FontDescription::fromFont(const QFont &font, const QString &family, const QString &styleName)
+{
+    FontDescription d;
+    d.family = family;
+    d.styleName = styleName;
+    d.pointSize = font.pointSizeF();
+    d.pixelSize = font.pixelSize();
+    d.styleHint = font.styleHint();
+    d.weight = font.weight();
+    d.style = font.style();
+    d.underline = font.underline();
+    d.strikeOut = font.strikeOut();
+    d.fixedPitch = font.fixedPitch();
+    d.fields = styleName.isEmpty() ? 10 : 11;
+    return d;
+}
+
+QString FontDescription::toString(const QFont &font)
+{
+    const QString family = font.family();
+    const QString styleName = font.styleName();
+    return fromFont(font, family, styleName).toString();
+}
+
+bool FontDescription::fromString(QStringView text, QFont *font)
+{
+    FontDescription d;
+    if (!d.parse(text)) {
+        return false;
+    }
+    d.applyTo(font);
+    return true;
+}
@@ -0,0 +1,72 @@
+/*!
+ *  @file fontdescription.h
+ *
+ *  Parses and writes the comma-separated font descriptions of
+ *  QFont::toString() and QFont::fromString() without heap allocations.
+ *
+ */
+
+#ifndef FONTDESCRIPTION_H
+#define FONTDESCRIPTION_H
+
+#include <QFont>
+#include <QString>
+#include <QStringView>
+
+/**
+ * The values of a QFont::toString() description. The names are views into
+ * the parsed text, or into the strings of the font it was made from, and
+ * are only valid as long as those are.
+ */
+struct FontDescription
+{
+    QStringView family;
+    QStringView styleName;  ///< with 11 fields only
+    qreal pointSize = -1;   ///< applied when > 0
+    int pixelSize = -1;     ///< applied when > 0, with 10 or 11 fields
+    int styleHint = QFont::AnyStyle;
+    int weight = QFont::Normal;
+    int style = QFont::StyleNormal;     ///< from the italic flag with 9 fields
+    bool underline = false;
+    bool strikeOut = false;
+    bool fixedPitch = false;
+    int fields = 0;         ///< 1, 2, 9, 10 or 11; which of the above are set
+
+    /**
+     * Parses @p text by the rules of the Qt 5 QFont::fromString(): the
+     * text is trimmed, and 1, 2, 9 (Qt 3), 10 or 11 fields with a non-empty
+     * family are accepted. Numbers that do not parse count as 0, as they do
+     * there. Unlike QFont::fromString() this does not warn.
+     * @return false for an invalid description, leaving this unchanged
+     */
+    bool parse(QStringView text);
+
+    /**
+     * Applies the description to @p font the way QFont::fromString() does:
+     * only the fields that were given change.
+     */
+    void applyTo(QFont *font) const;
+
+    /**
+     * Writes what QFont::toString() returns for a font with these values:
+     * 10 fields, and the style name as the 11th when there is one. Writes
+     * at most @p size characters.
+     * @return the length of the complete description
+     */
+    int format(QChar *buffer, int size) const;
+
+    QString toString() const;
+
+    /**
+     * The description of @p font, whose names must outlive it.
+     */
+    static FontDescription fromFont(const QFont &font, const QString &family, const QString &styleName);
+
+    /**
+     * QFont::toString() and QFont::fromString() through a FontDescription.
+     */
+    static QString toString(const QFont &font);
+    static bool fromString(QStringView text, QFont *font);
+};
+
+#endif // FONTDESCRIPTION_H
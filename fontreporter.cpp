@@ -0,0 +1,165 @@
+/*!
+ *  @file fontreporter.cpp
+ *
+ *  Computes the QFontInfo/QFontMetrics reports of the selected fonts on a
+ *  worker thread and hands the latest one back to the GUI thread.
+ *
+ */
+
+#include "fontreporter.h"
+#include "benchmark.h"
+#include "diagnostics.h"
+#include "fontweightmapper.h"
+#include "timing.h"
+#include "kwidgetsaddons/fontcatalog_p.h"
+
+#include <QFontInfo>
+#include <QFontMetrics>
+#include <QRunnable>
+
+namespace {
+
+// QFontInfo and QFontMetrics load the font engine on a cold cache, which is
+// why this runs on the worker; the rest only adds to the records.
+FontReport computeFontReport(const QFont &font,
+                             const QMap<QFont::Style, QString> &styleNames,
+                             const QMap<QFont::StyleHint, QString> &styleHintNames)
+{
+    HRTime_tic();
+    FontReport report;
+    report.font = font;
+    report.databaseFont = font;
+    QFontInfo fi(font);
+    report.family = fi.family();
+    const FontCatalog *db = FontCatalog::instance();
+    if (!font.styleName().isEmpty()) {
+        report.databaseFont = db->font(font.family(), font.styleName(), font.pointSize());
+    }
+    DIAG(FontDetails, "font")
+        .field("font", font.toString())
+        .field("exactMatch", fi.exactMatch())
+        .field("family", fi.family())
+        .field("styleName", fi.styleName())
+        .field("style", styleNames.value(fi.style()))
+        .field("bold", fi.bold())
+        .field("pointSize", fi.pointSizeF())
+        .field("pixelSize", fi.pixelSize())
+        .field("weight", fi.weight())
+        .field("stretch", font.stretch())
+        .field("letterSpacing", font.letterSpacing())
+        .field("letterSpacingType", int(font.letterSpacingType()))
+        .field("styleHint", styleHintNames.value(fi.styleHint()))
+        .field("fixedPitch", fi.fixedPitch())
+        .field("styleString", db->styleString(font))
+        .field("styleNameWeight", font.styleName().isEmpty() ? QVariant()
+               : QVariant(FontWeightMapper::forCurrentLocale().weight(font.styleName())))
+        .field("databaseFont", font.styleName().isEmpty() ? QVariant() : QVariant(report.databaseFont.toString()));
+    if (Diagnostics::isEnabled(Diagnostics::FontDetails)) {
+        const QFontMetrics fm(font);
+        DIAG(FontDetails, "metrics")
+            .field("font", font.toString())
+            .field("leading", fm.leading())
+            .field("ascent", fm.ascent())
+            .field("descent", fm.descent())
+            .field("minLeftBearing", fm.minLeftBearing())
+            .field("minRightBearing", fm.minRightBearing())
+            .field("averageCharWidth", fm.averageCharWidth())
+            .field("height", fm.height())
+            .field("xHeight", fm.xHeight())
+            .field("maxWidth", fm.maxWidth());
+    }
+    report.seconds = HRTime_toc();
+    return report;
+}
+
+} // namespace
+
+class FontReporter::Job : public QRunnable
+{
+public:
+    Job(FontReporter *reporter, const QFont &font, quint64 sequence, double requested, const Callback &onArrival)
+        : reporter(reporter)
+        , font(font)
+        , sequence(sequence)
+        , requested(requested)
+        , onArrival(onArrival)
+    {}
+
+    void run() override
+    {
+        if (reporter->m_latest.loadAcquire() != sequence) {
+            return;
+        }
+        const FontReport report = computeFontReport(font, reporter->m_styleNames, reporter->m_styleHintNames);
+        // the job is deleted after run(), so the call takes copies; the
+        // reporter waits for the job before it goes away
+        FontReporter *const target = reporter;
+        const quint64 seq = sequence;
+        const double start = requested;
+        const Callback callback = onArrival;
+        QMetaObject::invokeMethod(target, [target, seq, start, report, callback]() {
+            FontReport arrived = report;
+            arrived.latency = HRTime_Time() - start;
+            target->deliver(seq, arrived, callback);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    FontReporter *const reporter;
+    const QFont font;
+    const quint64 sequence;
+    const double requested;
+    const Callback onArrival;
+};
+
+FontReporter::FontReporter(const QMap<QFont::Style, QString> &styleNames,
+                           const QMap<QFont::StyleHint, QString> &styleHintNames, QObject *parent)
+    : QObject(parent)
+    , m_styleNames(styleNames)
+    , m_styleHintNames(styleHintNames)
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+FontReporter::~FontReporter()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+void FontReporter::request(const QFont &font, const Callback &onArrival)
+{
+    const quint64 sequence = ++m_requests;
+    m_latest.storeRelease(sequence);
+    const double requested = HRTime_Time();
+    if (m_synchronous) {
+        FontReport report = computeFontReport(font, m_styleNames, m_styleHintNames);
+        report.latency = HRTime_Time() - requested;
+        deliver(sequence, report, onArrival);
+        return;
+    }
+    // whatever still waits for the worker is stale now
+    m_pool.clear();
+    m_pool.start(new Job(this, font, sequence, requested, onArrival));
+}
+
+double FontReporter::medianLatency() const
+{
+    return Benchmark::median(m_latencies);
+}
+
+void FontReporter::deliver(quint64 sequence, const FontReport &report, const Callback &onArrival)
+{
+    if (sequence != m_latest.loadAcquire()) {
+        return;
+    }
+    m_latencies.append(report.latency);
+    DIAG(Timing, "fontReport")
+        .field("font", report.font.toString())
+        .field("seconds", report.seconds)
+        .field("latency", report.latency)
+        .field("synchronous", m_synchronous);
+    if (onArrival) {
+        onArrival(report);
+    }
+}
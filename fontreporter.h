@@ -0,0 +1,99 @@
+/*!
+ *  @file fontreporter.h
+ *
+ *  Computes the QFontInfo/QFontMetrics reports of the selected fonts on a
+ *  worker thread and hands the latest one back to the GUI thread.
+ *
+ */
+
+#ifndef FONTREPORTER_H
+#define FONTREPORTER_H
+
+#include <QAtomicInteger>
+#include <QFont>
+#include <QMap>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+
+#include <functional>
+
+struct FontReport {
+    QFont font;             // the font the report is about
+    QString family;         // QFontInfo::family(), the family actually used
+    QFont databaseFont;     // the database font for the style name, or font
+    double seconds = 0;     // spent computing the report
+    double latency = 0;     // from the request until the report arrived
+};
+
+class FontReporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef std::function<void(const FontReport &)> Callback;
+
+    /**
+     * @p styleNames and @p styleHintNames give the names used in the
+     * diagnostics records.
+     */
+    FontReporter(const QMap<QFont::Style, QString> &styleNames,
+                 const QMap<QFont::StyleHint, QString> &styleHintNames, QObject *parent = nullptr);
+    ~FontReporter();
+
+    /**
+     * Computes the report for @p font, writes it to the diagnostics and calls
+     * @p onArrival with it on this object's thread. A report that is
+     * overtaken by a later request is dropped, before it is computed if it
+     * is still waiting for the worker.
+     */
+    void request(const QFont &font, const Callback &onArrival);
+
+    /**
+     * Computes the reports on the calling thread instead, before request()
+     * returns; for comparison.
+     */
+    void setSynchronous(bool synchronous)
+    {
+        m_synchronous = synchronous;
+    }
+    bool isSynchronous() const
+    {
+        return m_synchronous;
+    }
+
+    quint64 requests() const
+    {
+        return m_requests;
+    }
+    /**
+     * @return the number of reports that were overtaken by a later request
+     * (or are still on their way)
+     */
+    quint64 dropped() const
+    {
+        return m_requests - quint64(m_latencies.size());
+    }
+    /**
+     * @return the median time in seconds from request() until the report
+     * arrived
+     */
+    double medianLatency() const;
+
+private:
+    void deliver(quint64 sequence, const FontReport &report, const Callback &onArrival);
+
+    class Job;
+
+    const QMap<QFont::Style, QString> m_styleNames;
+    const QMap<QFont::StyleHint, QString> m_styleHintNames;
+    // a single worker: a burst of requests only ever computes the last one
+    QThreadPool m_pool;
+    QAtomicInteger<quint64> m_latest;
+    quint64 m_requests = 0;
+    QVector<double> m_latencies;
+    bool m_synchronous = false;
+};
+
+#endif // FONTREPORTER_H
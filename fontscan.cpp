@@ -0,0 +1,180 @@
+/*!
+ *  @file fontscan.cpp
+ *
+ *  Headless scan of a directory tree of font files through QRawFont.
+ *
+ */
+
+#include "fontscan.h"
+#include "timing.h"
+
+#include <QAtomicInt>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRawFont>
+#include <QRunnable>
+#include <QSet>
+#include <QThreadPool>
+#include <QDebug>
+
+#include <cstring>
+
+bool fontScanRequested(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--scan-fonts") || !strncmp(argv[i], "--scan-fonts=", 13)
+                || !strcmp(argv[i], "-scan-fonts") || !strncmp(argv[i], "-scan-fonts=", 12)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+
+// the metrics are reported in pixels at this size
+const qreal ScanPixelSize = 100;
+
+// Serialises the report lines of the workers.
+class ScanSink
+{
+public:
+    explicit ScanSink(QFile *report)
+        : report(report)
+    {}
+
+    void write(const QJsonObject &record, bool loaded)
+    {
+        QByteArray line = QJsonDocument(record).toJson(QJsonDocument::Compact);
+        line += '\n';
+        QMutexLocker locker(&lock);
+        if (report->write(line) != line.size()) {
+            writeErrors.ref();
+        }
+        if (!loaded) {
+            failures.ref();
+        }
+    }
+
+    QAtomicInt failures;
+    QAtomicInt writeErrors;
+
+private:
+    QFile *report;
+    QMutex lock;
+};
+
+class FileScan : public QRunnable
+{
+public:
+    FileScan(const QString &fileName, ScanSink *sink)
+        : fileName(fileName)
+        , sink(sink)
+    {}
+
+    void run() override;
+
+private:
+    const QString fileName;
+    ScanSink *sink;
+};
+
+void FileScan::run()
+{
+    const QRawFont font(fileName, ScanPixelSize, QFont::PreferNoHinting);
+
+    QJsonObject record;
+    record.insert(QStringLiteral("file"), fileName);
+    record.insert(QStringLiteral("valid"), font.isValid());
+    if (font.isValid()) {
+        record.insert(QStringLiteral("family"), font.familyName());
+        record.insert(QStringLiteral("styleName"), font.styleName());
+        record.insert(QStringLiteral("weight"), font.weight());
+        switch (font.style()) {
+        case QFont::StyleNormal:
+            record.insert(QStringLiteral("style"), QStringLiteral("normal"));
+            break;
+        case QFont::StyleItalic:
+            record.insert(QStringLiteral("style"), QStringLiteral("italic"));
+            break;
+        case QFont::StyleOblique:
+            record.insert(QStringLiteral("style"), QStringLiteral("oblique"));
+            break;
+        }
+        record.insert(QStringLiteral("pixelSize"), font.pixelSize());
+        record.insert(QStringLiteral("unitsPerEm"), font.unitsPerEm());
+        record.insert(QStringLiteral("ascent"), font.ascent());
+        record.insert(QStringLiteral("descent"), font.descent());
+        record.insert(QStringLiteral("xHeight"), font.xHeight());
+        record.insert(QStringLiteral("capHeight"), font.capHeight());
+        record.insert(QStringLiteral("averageCharWidth"), font.averageCharWidth());
+    }
+    sink->write(record, font.isValid());
+}
+
+bool isFontFile(const QFileInfo &info)
+{
+    static const QSet<QString> suffixes = QSet<QString>()
+        << QStringLiteral("ttf") << QStringLiteral("otf") << QStringLiteral("ttc")
+        << QStringLiteral("otc") << QStringLiteral("pfa") << QStringLiteral("pfb")
+        << QStringLiteral("woff") << QStringLiteral("woff2") << QStringLiteral("dfont");
+    return suffixes.contains(info.suffix().toLower());
+}
+
+} // namespace
+
+int runFontScan(const QString &directory, const QString &reportFile, int jobs)
+{
+    if (!QFileInfo(directory).isDir()) {
+        qWarning() << directory << "is not a directory";
+        return 2;
+    }
+    QFile report;
+    bool opened;
+    if (reportFile.isEmpty() || reportFile == QLatin1String("-")) {
+        opened = report.open(stdout, QIODevice::WriteOnly);
+    } else {
+        report.setFileName(reportFile);
+        opened = report.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    }
+    if (!opened) {
+        qWarning() << "Cannot open" << reportFile << "for writing:" << report.errorString();
+        return 2;
+    }
+
+    init_HRTime();
+    HRTime_tic();
+
+    ScanSink sink(&report);
+    QThreadPool pool;
+    if (jobs > 0) {
+        pool.setMaxThreadCount(jobs);
+    }
+    // the workers start on the first files while the tree is still being walked
+    int files = 0;
+    QDirIterator it(directory, QDir::Files | QDir::Readable, QDirIterator::Subdirectories | QDirIterator::FollowSymlinks);
+    while (it.hasNext()) {
+        it.next();
+        if (isFontFile(it.fileInfo())) {
+            pool.start(new FileScan(it.filePath(), &sink));
+            files += 1;
+        }
+    }
+    pool.waitForDone();
+    report.close();
+
+    const int failures = sink.failures.load();
+    qInfo() << "Scanned" << files << "font files with" << pool.maxThreadCount() << "threads in"
+        << HRTime_toc() << "seconds;" << failures << "could not be loaded";
+    if (sink.writeErrors.load()) {
+        qWarning() << "Failed to write" << sink.writeErrors.load() << "records to" << reportFile;
+        return 2;
+    }
+    return failures ? 1 : 0;
+}
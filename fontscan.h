@@ -0,0 +1,31 @@
+/*!
+ *  @file fontscan.h
+ *
+ *  Headless scan of a directory tree of font files through QRawFont.
+ *
+ */
+
+#ifndef FONTSCAN_H
+#define FONTSCAN_H
+
+#include <QString>
+
+/**
+ * Returns true if the command line requests a font directory scan; like
+ * batchModeRequested() this is needed before the QApplication exists.
+ */
+bool fontScanRequested(int argc, char *argv[]);
+
+/**
+ * Loads every font file below @p directory into a QRawFont, using up to
+ * @p jobs worker threads (all cores when <= 0), and writes one JSON object
+ * per file to @p reportFile ("-" for stdout) as soon as it has been loaded.
+ * Records appear in completion order; each carries the file path.
+ * Only the first face of a font collection is inspected.
+ *
+ * @return the process exit code: 0 if all files could be loaded, 1 if any
+ * could not, 2 on I/O errors.
+ */
+int runFontScan(const QString &directory, const QString &reportFile, int jobs);
+
+#endif // FONTSCAN_H
@@ -0,0 +1,220 @@
+/*!
+ *  @file fontstyleclassifier.cpp
+ *
+ *  An Aho-Corasick automaton over case-folded UTF-16 code units that maps
+ *  a style string to its weight classes and slant in one pass.
+ *
+ */
+
+#include "fontstyleclassifier.h"
+
+#include <QCoreApplication>
+#include <QLocale>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <algorithm>
+
+// internal class bit for the italic/oblique synonyms
+static const uint SlantBit = 0x80000000U;
+
+static inline ushort foldedUnit(ushort u)
+{
+    return ushort(QChar::toCaseFolded(uint(u)));
+}
+
+FontStyleClassifier::FontStyleClassifier()
+    : m_dirty(true)
+{
+}
+
+void FontStyleClassifier::addSynonyms(WeightClass weightClass, const QStringList &synonyms)
+{
+    const uint bits = weightClass == NoWeightClass ? SlantBit : uint(weightClass);
+    for (const QString &synonym : synonyms) {
+        // QString::contains(QString()) is always true, which would make
+        // every style a member of this class.
+        if (!synonym.isEmpty()) {
+            m_synonyms.append(qMakePair(bits, synonym));
+        }
+    }
+    m_dirty = true;
+}
+
+const FontStyleClassifier &FontStyleClassifier::forCurrentLocale()
+{
+    static QMutex lock;
+    static QHash<QString, FontStyleClassifier *> classifiers;
+
+    QMutexLocker locker(&lock);
+    const QString localeName = QLocale().name();
+    FontStyleClassifier *classifier = classifiers.value(localeName);
+    if (!classifier) {
+        // the synonym lists from QFontDialogPrivate::init() in the patches
+        classifier = new FontStyleClassifier;
+        classifier->addSynonyms(LightClass, QStringList()
+            << QCoreApplication::translate("QFontDatabase", "Thin")
+            << QCoreApplication::translate("QFontDatabase", "Light"));
+        classifier->addSynonyms(BookClass, QStringList()
+            << QCoreApplication::translate("QFontDatabase", "Semilight")
+            << QCoreApplication::translate("QFontDatabase", "Semi Light")
+            << QCoreApplication::translate("QFontDatabase", "Book"));
+        classifier->addSynonyms(NormalClass, QStringList()
+            << QCoreApplication::translate("QFontDatabase", "Normal")
+            << QCoreApplication::translate("QFontDatabase", "Regular")
+            << QCoreApplication::translate("QFontDatabase", "Roman"));
+        classifier->addSynonyms(MediumClass, QStringList()
+            << QCoreApplication::translate("QFontDatabase", "Medium"));
+        classifier->addSynonyms(DemiBoldClass, QStringList()
+            << QCoreApplication::translate("QFontDatabase", "DemiBold")
+            << QCoreApplication::translate("QFontDatabase", "Demi Bold")
+            << QCoreApplication::translate("QFontDatabase", "SemiBold")
+            << QCoreApplication::translate("QFontDatabase", "Semi Bold"));
+        classifier->addSynonyms(BlackClass, QStringList()
+            << QCoreApplication::translate("QFontDatabase", "Black")
+            << QCoreApplication::translate("QFontDatabase", "Ultra")
+            << QCoreApplication::translate("QFontDatabase", "Heavy")
+            << QCoreApplication::translate("QFontDatabase", "UltraBold"));
+        classifier->addSynonyms(NoWeightClass, QStringList()
+            << QCoreApplication::translate("QFontDatabase", "Italic")
+            << QCoreApplication::translate("QFontDatabase", "Oblique"));
+        // build now so that the shared instance is never modified after publication
+        classifier->build();
+        classifiers.insert(localeName, classifier);
+    }
+    return *classifier;
+}
+
+void FontStyleClassifier::build() const
+{
+    // Construct the trie with ordered child maps first, then flatten it
+    // into contiguous node and (sorted) edge arrays.
+    struct TrieNode {
+        QMap<ushort, int> children;
+        int depth;
+        uint terminal;
+    };
+    QVector<TrieNode> trie;
+    trie.append(TrieNode{QMap<ushort, int>(), 0, 0});
+
+    for (const auto &synonym : m_synonyms) {
+        int state = 0;
+        const QString &pattern = synonym.second;
+        for (int i = 0; i < pattern.size(); ++i) {
+            const ushort u = foldedUnit(pattern.at(i).unicode());
+            int next = trie[state].children.value(u, -1);
+            if (next < 0) {
+                next = trie.size();
+                trie.append(TrieNode{QMap<ushort, int>(), trie[state].depth + 1, 0});
+                trie[state].children.insert(u, next);
+            }
+            state = next;
+        }
+        trie[state].terminal |= synonym.first;
+    }
+
+    m_nodes.resize(trie.size());
+    m_edges.clear();
+    for (int n = 0; n < trie.size(); ++n) {
+        Node &node = m_nodes[n];
+        node.firstEdge = m_edges.size();
+        node.edgeCount = trie[n].children.size();
+        node.fail = 0;
+        node.depth = trie[n].depth;
+        node.terminal = node.output = trie[n].terminal;
+        for (auto it = trie[n].children.constBegin(); it != trie[n].children.constEnd(); ++it) {
+            m_edges.append(Edge{it.key(), it.value()});
+        }
+    }
+
+    // Breadth-first computation of the failure links; a node's output
+    // includes everything recognised along its failure chain.
+    QVector<int> queue;
+    queue.reserve(m_nodes.size());
+    for (int e = 0; e < m_nodes[0].edgeCount; ++e) {
+        queue.append(m_edges[m_nodes[0].firstEdge + e].target);
+    }
+    for (int head = 0; head < queue.size(); ++head) {
+        const int n = queue[head];
+        for (int e = 0; e < m_nodes[n].edgeCount; ++e) {
+            const Edge &edge = m_edges[m_nodes[n].firstEdge + e];
+            // the failure state of n is shallower than n, so stepping from
+            // it can never lead back into the subtree being labelled
+            const int fallback = step(m_nodes[n].fail, edge.ch);
+            m_nodes[edge.target].fail = fallback;
+            m_nodes[edge.target].output |= m_nodes[fallback].output;
+            queue.append(edge.target);
+        }
+    }
+    m_dirty = false;
+}
+
+inline int FontStyleClassifier::step(int state, ushort ch) const
+{
+    forever {
+        const Node &node = m_nodes[state];
+        const Edge *first = m_edges.constData() + node.firstEdge;
+        const Edge *last = first + node.edgeCount;
+        const Edge *edge = std::lower_bound(first, last, ch,
+                                            [](const Edge &e, ushort c) { return e.ch < c; });
+        if (edge != last && edge->ch == ch) {
+            return edge->target;
+        }
+        if (state == 0) {
+            return 0;
+        }
+        state = node.fail;
+    }
+}
+
+FontStyleClassifier::Classification FontStyleClassifier::classify(const QString &style) const
+{
+    if (m_dirty) {
+        build();
+    }
+    uint partial = 0;
+    int state = 0;
+    const ushort *u = style.utf16();
+    const int length = style.size();
+    for (int i = 0; i < length; ++i) {
+        state = step(state, foldedUnit(u[i]));
+        partial |= m_nodes[state].output;
+    }
+    // The final state spells the longest suffix of the input that is a
+    // prefix of some synonym; if it spans the whole input we have an exact hit.
+    const uint exact = (length > 0 && m_nodes[state].depth == length) ? m_nodes[state].terminal : 0;
+
+    Classification result;
+    result.exact = WeightClasses(QFlag(int(exact & ~SlantBit)));
+    result.partial = WeightClasses(QFlag(int(partial & ~SlantBit)));
+    result.slanted = (partial & SlantBit) != 0;
+    return result;
+}
+
+FontStyleClassifier::WeightClasses FontStyleClassifier::adjusted(WeightClasses weights, MatchOptions options)
+{
+    if ((options & BookIsLight) && (weights & BookClass)) {
+        weights |= LightClass;
+    }
+    if ((options & MediumIsDemiBold) && (weights & MediumClass)) {
+        weights |= DemiBoldClass;
+    }
+    return weights;
+}
+
+FontStyleClassifier::WeightClasses FontStyleClassifier::classes(const QString &style, bool exact, MatchOptions options) const
+{
+    const Classification c = classify(style);
+    return adjusted(exact ? c.exact : c.partial, options);
+}
+
+bool FontStyleClassifier::matches(const QString &style1, const QString &style2, bool exact, MatchOptions options) const
+{
+    const Classification c1 = classify(style1);
+    const Classification c2 = classify(style2);
+    const WeightClasses w1 = adjusted(exact ? c1.exact : c1.partial, options);
+    const WeightClasses w2 = adjusted(exact ? c2.exact : c2.partial, options);
+    return (int(w1) & int(w2)) != 0 && c1.slanted == c2.slanted;
+}
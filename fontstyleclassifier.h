@@ -0,0 +1,113 @@
+/*!
+ *  @file fontstyleclassifier.h
+ *
+ *  Single-pass classification of font style strings into the weight classes
+ *  and slant used by the font weight patches (see patches/qt5xx), replacing
+ *  the repeated linear QStringList scans of qstringCompareToList().
+ *
+ */
+
+#ifndef FONTSTYLECLASSIFIER_H
+#define FONTSTYLECLASSIFIER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QFlags>
+
+class FontStyleClassifier
+{
+public:
+    /**
+     * The weight classes distinguished by QFontDialogPrivate::updateStyles().
+     * A style string can belong to several classes at once ("Semi Light"
+     * contains both a Light and a Book synonym).
+     */
+    enum WeightClass {
+        NoWeightClass = 0,
+        LightClass = 0x01,
+        BookClass = 0x02,
+        NormalClass = 0x04,
+        MediumClass = 0x08,
+        DemiBoldClass = 0x10,
+        BlackClass = 0x20
+    };
+    Q_DECLARE_FLAGS(WeightClasses, WeightClass)
+
+    /**
+     * Synonym extensions that updateStyles() applies depending on the
+     * styles a family actually provides.
+     */
+    enum MatchOption {
+        NoMatchOptions = 0,
+        BookIsLight = 0x01,         ///< Book was demoted to Light: treat Book synonyms as Light
+        MediumIsDemiBold = 0x02     ///< a deduced Medium style: treat Medium as DemiBold
+    };
+    Q_DECLARE_FLAGS(MatchOptions, MatchOption)
+
+    struct Classification {
+        WeightClasses exact;    ///< classes with a synonym equal to the whole string
+        WeightClasses partial;  ///< classes with a synonym contained in the string
+        bool slanted;           ///< the string contains an italic/oblique synonym
+    };
+
+    FontStyleClassifier();
+
+    /**
+     * Register synonyms for a weight class, or for the slant when
+     * @p weightClass is NoWeightClass. Synonyms are matched case-insensitively;
+     * empty strings are ignored. The automaton is rebuilt lazily.
+     */
+    void addSynonyms(WeightClass weightClass, const QStringList &synonyms);
+
+    /**
+     * @return a classifier built from the translated synonym lists of the
+     * font weight patches. One instance is built per locale and kept for
+     * the lifetime of the application; it is safe to use from any thread.
+     */
+    static const FontStyleClassifier &forCurrentLocale();
+
+    /**
+     * Classify @p style in a single pass over its case-folded UTF-16 code units.
+     */
+    Classification classify(const QString &style) const;
+
+    WeightClasses classes(const QString &style, bool exact, MatchOptions options = NoMatchOptions) const;
+
+    /**
+     * Equivalent of the synonym test in the patched updateStyles():
+     * @p style1 and @p style2 share a weight class and have the same slant.
+     */
+    bool matches(const QString &style1, const QString &style2, bool exact,
+                 MatchOptions options = NoMatchOptions) const;
+
+    static WeightClasses adjusted(WeightClasses weights, MatchOptions options);
+
+private:
+    void build() const;
+
+    struct Edge {
+        ushort ch;
+        int target;
+    };
+    struct Node {
+        int firstEdge;
+        int edgeCount;
+        int fail;
+        int depth;
+        uint terminal;  // classes of the synonyms ending exactly here
+        uint output;    // terminal | output of the failure chain
+    };
+
+    inline int step(int state, ushort ch) const;
+
+    QVector<QPair<uint, QString> > m_synonyms;
+    mutable QVector<Node> m_nodes;
+    mutable QVector<Edge> m_edges;
+    mutable bool m_dirty;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(FontStyleClassifier::WeightClasses)
+Q_DECLARE_OPERATORS_FOR_FLAGS(FontStyleClassifier::MatchOptions)
+
+#endif // FONTSTYLECLASSIFIER_H
@@ -1,19 +1,51 @@
 QT += widgets core-private gui-private
+!greaterThan(QT_MAJOR_VERSION, 5):lessThan(QT_MINOR_VERSION, 10) {
+    error("Qt 5.10 or newer is required")
+}
 CONFIG += release c++11 rpath
 QMAKE_CXXFLAGS_RELEASE -= -pipe -O2
 QMAKE_CXXFLAGS_RELEASE += -g -O3 -march=native
 
 HEADERS       = dialog.h timing.c timing.h \
+                fontstyleclassifier.h \
+                fontweightmapper.h \
+                batchcheck.h \
+                fontscan.h \
+                mappedfontfile.h \
+                settingswriter.h \
+                diagnostics.h \
+                fontreporter.h \
+                fontdescription.h \
+                storedfont.h \
+                benchmark.h \
                 kwidgetsaddons/fonthelpers_p.h \
+                kwidgetsaddons/fontcatalog_p.h \
+                kwidgetsaddons/fontnamelistmodel_p.h \
                 kwidgetsaddons/kfontchooser.h \
                 kwidgetsaddons/kfontchooserdialog.h \
-                kwidgetsaddons/kfontrequester.h
+                kwidgetsaddons/kfontrequester.h \
+                kwidgetsaddons/nearestfontresolver_p.h
 SOURCES       = dialog.cpp \
                 main.cpp \
+                fontstyleclassifier.cpp \
+                fontweightmapper.cpp \
+                batchcheck.cpp \
+                fontscan.cpp \
+                mappedfontfile.cpp \
+                settingswriter.cpp \
+                diagnostics.cpp \
+                fontreporter.cpp \
+                fontdescription.cpp \
+                storedfont.cpp \
+                benchmark.cpp \
+                kwidgetsaddons/fontnamelistmodel.cpp \
                 kwidgetsaddons/kfontchooser.cpp \
                 kwidgetsaddons/kfontchooserdialog.cpp \
                 kwidgetsaddons/kfontrequester.cpp \
-                kwidgetsaddons/fonthelpers.cpp
+                kwidgetsaddons/nearestfontresolver.cpp \
+                kwidgetsaddons/fonthelpers.cpp \
+                kwidgetsaddons/fontcatalog.cpp \
+                kwidgetsaddons/fontcatalogcache.cpp
 
 # install
 target.path = $$[QT_INSTALL_EXAMPLES]/widgets/dialogs/fontweightissue
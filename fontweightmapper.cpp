@@ -0,0 +1,329 @@
+/*!
+ *  @file fontweightmapper.cpp
+ *
+ *  getFontWeight() over a lowercased copy of the style string on the stack,
+ *  with the translated keywords looked up once per locale.
+ *
+ */
+
+#include "fontweightmapper.h"
+
+#include <QCoreApplication>
+#include <QFont>
+#include <QHash>
+#include <QLocale>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVarLengthArray>
+
+#include <cstring>
+
+namespace {
+
+// Tests on a lowercased string s of length n; literals are ASCII.
+
+template <int N>
+inline bool equals(const ushort *s, int n, const char (&literal)[N])
+{
+    if (n != N - 1) {
+        return false;
+    }
+    for (int i = 0; i < n; ++i) {
+        if (s[i] != ushort(uchar(literal[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool equals(const ushort *s, int n, const QString &key)
+{
+    return n == key.size() && (n == 0 || memcmp(s, key.utf16(), n * sizeof(ushort)) == 0);
+}
+
+// QString::compare(key, Qt::CaseInsensitive) == 0 for a pre-folded key
+inline bool equalsFolded(const ushort *s, int n, const QString &foldedKey)
+{
+    if (n != foldedKey.size()) {
+        return false;
+    }
+    const ushort *k = foldedKey.utf16();
+    for (int i = 0; i < n; ++i) {
+        if (s[i] != k[i] && QChar::toCaseFolded(s[i]) != k[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool contains(const ushort *s, int n, const ushort *key, int m)
+{
+    for (int i = 0; i + m <= n; ++i) {
+        int j = 0;
+        while (j < m && s[i + j] == key[j]) {
+            ++j;
+        }
+        if (j == m) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <int N>
+inline bool contains(const ushort *s, int n, const char (&literal)[N])
+{
+    ushort key[N - 1];
+    for (int i = 0; i < N - 1; ++i) {
+        key[i] = uchar(literal[i]);
+    }
+    return contains(s, n, key, N - 1);
+}
+
+inline bool contains(const ushort *s, int n, const QString &key)
+{
+    return contains(s, n, key.utf16(), key.size());
+}
+
+QString folded(const QString &str)
+{
+    QString result = str;
+    ushort *u = reinterpret_cast<ushort *>(result.data());
+    for (int i = 0; i < result.size(); ++i) {
+        u[i] = QChar::toCaseFolded(u[i]);
+    }
+    return result;
+}
+
+} // namespace
+
+FontWeightMapper::FontWeightMapper()
+    : m_bold(QCoreApplication::translate("QFontDatabase", "Bold").toLower())
+    , m_light(QCoreApplication::translate("QFontDatabase", "Light").toLower())
+    , m_semiLight(QCoreApplication::translate("QFontDatabase", "SemiLight").toLower())
+    , m_book(QCoreApplication::translate("QFontDatabase", "Book").toLower())
+    , m_extra(QCoreApplication::translate("QFontDatabase", "Extra").toLower())
+    , m_demi(QCoreApplication::translate("QFontDatabase", "Demi").toLower())
+    , m_semi(QCoreApplication::translate("QFontDatabase", "Semi").toLower())
+    , m_normal(folded(QCoreApplication::translate("QFontDatabase", "Normal", "The Normal or Regular font weight")))
+    , m_regular(folded(QCoreApplication::translate("QFontDatabase", "Regular", "The Normal or Regular font weight")))
+    , m_demiBold(folded(QCoreApplication::translate("QFontDatabase", "Demi Bold")))
+    , m_semiBold(folded(QCoreApplication::translate("QFontDatabase", "Semi Bold")))
+    , m_medium(folded(QCoreApplication::translate("QFontDatabase", "Medium", "The Medium font weight")))
+    , m_black(folded(QCoreApplication::translate("QFontDatabase", "Black")))
+    , m_heavy(folded(QCoreApplication::translate("QFontDatabase", "Heavy")))
+    , m_thin(folded(QCoreApplication::translate("QFontDatabase", "Thin")))
+    , m_extraLight(folded(QCoreApplication::translate("QFontDatabase", "Extra Light")))
+    , m_extraBold(folded(QCoreApplication::translate("QFontDatabase", "Extra Bold")))
+{
+}
+
+const FontWeightMapper &FontWeightMapper::forCurrentLocale()
+{
+    static QMutex lock;
+    static QHash<QString, FontWeightMapper *> mappers;
+
+    QMutexLocker locker(&lock);
+    const QString localeName = QLocale().name();
+    FontWeightMapper *mapper = mappers.value(localeName);
+    if (!mapper) {
+        mapper = new FontWeightMapper;
+        mappers.insert(localeName, mapper);
+    }
+    return *mapper;
+}
+
+int FontWeightMapper::weight(const QString &styleString) const
+{
+    const int length = styleString.size();
+    const ushort *u = styleString.utf16();
+    QVarLengthArray<ushort, 64> lowered(length);
+    for (int i = 0; i < length; ++i) {
+        const ushort c = u[i];
+        if (c < 0x80) {
+            lowered[i] = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+        } else if (QChar::isSurrogate(c) || c == 0x130) {
+            // QString::toLower() handles these specially
+            return reference(styleString);
+        } else {
+            lowered[i] = QChar::toLower(c);
+        }
+    }
+    return lowercasedWeight(lowered.constData(), length);
+}
+
+// The same tests in the same order as reference(), on the lowercased string.
+int FontWeightMapper::lowercasedWeight(const ushort *s, int n) const
+{
+    if (equals(s, n, "normal") || equals(s, n, "regular"))
+        return QFont::Normal;
+    if (equals(s, n, "bold"))
+        return QFont::Bold;
+    if (equals(s, n, "semibold") || equals(s, n, "semi bold")
+            || equals(s, n, "demibold") || equals(s, n, "demi bold"))
+        return QFont::DemiBold;
+    if (equals(s, n, "medium"))
+        return QFont::Medium;
+    if (equals(s, n, "black") || equals(s, n, "heavy"))
+        return QFont::Black;
+    if (equals(s, n, "light") || equals(s, n, "book"))
+        return QFont::Light;
+    if (equals(s, n, "thin"))
+        return QFont::Thin;
+    if (n >= 2 && ((s[0] == 'e' && s[1] == 'x') || (s[0] == 'u' && s[1] == 'l'))) {
+        const ushort *s2 = s + 2;
+        const int n2 = n - 2;
+        // sic: the reference tests the whole string against "tra light"
+        if (equals(s2, n2, "tralight") || equals(s, n, "tra light"))
+            return QFont::ExtraLight;
+        if (equals(s2, n2, "trabold") || equals(s2, n2, "tra bold"))
+            return QFont::ExtraBold;
+    }
+
+    if (contains(s, n, "bold")) {
+        if (contains(s, n, "demi") || contains(s, n, "semi"))
+            return QFont::DemiBold;
+        return QFont::Bold;
+    }
+    if (contains(s, n, "thin"))
+        return QFont::Thin;
+    if (contains(s, n, "light") || contains(s, n, "book"))
+        return QFont::Light;
+    if (contains(s, n, "black") || contains(s, n, "heavy"))
+        return QFont::Black;
+
+    if (equalsFolded(s, n, m_normal) || equalsFolded(s, n, m_regular))
+        return QFont::Normal;
+    if (equals(s, n, m_bold))
+        return QFont::Bold;
+    if (equalsFolded(s, n, m_demiBold) || equalsFolded(s, n, m_semiBold))
+        return QFont::DemiBold;
+    if (equalsFolded(s, n, m_medium))
+        return QFont::Medium;
+    if (equalsFolded(s, n, m_black) || equalsFolded(s, n, m_heavy))
+        return QFont::Black;
+    if (equals(s, n, m_light) || equals(s, n, m_semiLight) || equals(s, n, m_book))
+        return QFont::Light;
+    if (equalsFolded(s, n, m_thin))
+        return QFont::Thin;
+    if (equalsFolded(s, n, m_extraLight))
+        return QFont::ExtraLight;
+    if (equalsFolded(s, n, m_extraBold))
+        return QFont::ExtraBold;
+
+    if (contains(s, n, m_bold)) {
+        if (contains(s, n, m_demi) || contains(s, n, m_semi))
+            return QFont::DemiBold;
+        if (contains(s, n, m_extra))
+            return QFont::ExtraBold;
+        return QFont::Bold;
+    }
+
+    if (contains(s, n, m_light)) {
+        if (contains(s, n, m_extra))
+            return QFont::ExtraLight;
+        return QFont::Light;
+    }
+    return QFont::Normal;
+}
+
+int FontWeightMapper::reference(const QString &weightString)
+{
+    QString s = weightString.toLower();
+
+    // Order here is important. We want to match the common cases first, but we
+    // must also take care to acknowledge the cost of our tests.
+    //
+    // As a result, we test in two orders; the order of commonness, and the
+    // order of "expense".
+    //
+    // A simple string test is the cheapest, so let's do that first.
+    // Test in decreasing order of commonness
+    if (s == QLatin1String("normal") || s == QLatin1String("regular"))
+        return QFont::Normal;
+    if (s == QLatin1String("bold"))
+        return QFont::Bold;
+    if (s == QLatin1String("semibold") || s == QLatin1String("semi bold")
+            || s == QLatin1String("demibold") || s == QLatin1String("demi bold"))
+        return QFont::DemiBold;
+    if (s == QLatin1String("medium"))
+        return QFont::Medium;
+    if (s == QLatin1String("black") || s == QLatin1String("heavy"))
+        return QFont::Black;
+    if (s == QLatin1String("light") || s == QLatin1String("book"))
+        return QFont::Light;
+    if (s == QLatin1String("thin"))
+        return QFont::Thin;
+    const QStringRef s2 = s.midRef(2);
+    if (s.startsWith(QLatin1String("ex")) || s.startsWith(QLatin1String("ul"))) {
+        if (s2 == QLatin1String("tralight") || s == QLatin1String("tra light"))
+            return QFont::ExtraLight;
+        if (s2 == QLatin1String("trabold") || s2 == QLatin1String("tra bold"))
+            return QFont::ExtraBold;
+    }
+
+    // Next up, let's see if contains() matches: slightly more expensive, but
+    // still fast enough.
+    if (s.contains(QLatin1String("bold"))) {
+        if (s.contains(QLatin1String("demi")) || s.contains(QLatin1String("semi")))
+            return QFont::DemiBold;
+        return QFont::Bold;
+    }
+    if (s.contains(QLatin1String("thin")))
+        return QFont::Thin;
+    if (s.contains(QLatin1String("light")) || s.contains(QLatin1String("book")))
+        return QFont::Light;
+    if (s.contains(QLatin1String("black")) || s.contains(QLatin1String("heavy")))
+        return QFont::Black;
+
+    // Now, we perform string translations & comparisons with those.
+    // These are (very) slow compared to simple string ops, so we do these last.
+    // As using translated values for such things is not very common, this should
+    // not be too bad.
+    if (s.compare(QCoreApplication::translate("QFontDatabase", "Normal", "The Normal or Regular font weight"), Qt::CaseInsensitive) == 0
+        || s.compare(QCoreApplication::translate("QFontDatabase", "Regular", "The Normal or Regular font weight"), Qt::CaseInsensitive) == 0)
+        return QFont::Normal;
+    const QString translatedBold = QCoreApplication::translate("QFontDatabase", "Bold").toLower();
+    if (s == translatedBold)
+        return QFont::Bold;
+    if (s.compare(QCoreApplication::translate("QFontDatabase", "Demi Bold"), Qt::CaseInsensitive) == 0
+        || s.compare(QCoreApplication::translate("QFontDatabase", "Semi Bold"), Qt::CaseInsensitive) == 0)
+        return QFont::DemiBold;
+    if (s.compare(QCoreApplication::translate("QFontDatabase", "Medium", "The Medium font weight"), Qt::CaseInsensitive) == 0)
+        return QFont::Medium;
+    if (s.compare(QCoreApplication::translate("QFontDatabase", "Black"), Qt::CaseInsensitive) == 0
+        || s.compare(QCoreApplication::translate("QFontDatabase", "Heavy"), Qt::CaseInsensitive) == 0)
+        return QFont::Black;
+    const QString translatedLight = QCoreApplication::translate("QFontDatabase", "Light").toLower();
+    const QString translatedSemiLight = QCoreApplication::translate("QFontDatabase", "SemiLight").toLower();
+    const QString translatedBook = QCoreApplication::translate("QFontDatabase", "Book").toLower();
+    if (s == translatedLight || s == translatedSemiLight || s == translatedBook)
+        return QFont::Light;
+    if (s.compare(QCoreApplication::translate("QFontDatabase", "Thin"), Qt::CaseInsensitive) == 0)
+        return QFont::Thin;
+    if (s.compare(QCoreApplication::translate("QFontDatabase", "Extra Light"), Qt::CaseInsensitive) == 0)
+        return QFont::ExtraLight;
+    if (s.compare(QCoreApplication::translate("QFontDatabase", "Extra Bold"), Qt::CaseInsensitive) == 0)
+        return QFont::ExtraBold;
+
+    // And now the contains() checks for the translated strings.
+    //: The word for "Extra" as in "Extra Bold, Extra Thin" used as a pattern for string searches
+    const QString translatedExtra = QCoreApplication::translate("QFontDatabase", "Extra").toLower();
+    if (s.contains(translatedBold)) {
+        //: The word for "Demi" as in "Demi Bold" used as a pattern for string searches
+        QString translatedDemi = QCoreApplication::translate("QFontDatabase", "Demi").toLower();
+        QString translatedSemi = QCoreApplication::translate("QFontDatabase", "Semi").toLower();
+        if (s .contains(translatedDemi) || s.contains(translatedSemi))
+            return QFont::DemiBold;
+        if (s.contains(translatedExtra))
+            return QFont::ExtraBold;
+        return QFont::Bold;
+    }
+
+    if (s.contains(translatedLight)) {
+        if (s.contains(translatedExtra))
+            return QFont::ExtraLight;
+        return QFont::Light;
+    }
+    return QFont::Normal;
+}
@@ -0,0 +1,52 @@
+/*!
+ *  @file fontweightmapper.h
+ *
+ *  The style string to QFont::Weight mapping of getFontWeight() in the patched
+ *  qfontdatabase.cpp (see patches/qt512), without the per-call lowercasing
+ *  and translation lookups.
+ *
+ */
+
+#ifndef FONTWEIGHTMAPPER_H
+#define FONTWEIGHTMAPPER_H
+
+#include <QString>
+
+class FontWeightMapper
+{
+public:
+    /**
+     * @return the mapper for the translations of the current locale. One
+     * instance is built per locale and kept for the lifetime of the
+     * application; it is safe to use from any thread. Looking up the
+     * instance takes a lock, so hold on to the reference in loops.
+     */
+    static const FontWeightMapper &forCurrentLocale();
+
+    /**
+     * @return the QFont::Weight getFontWeight() assigns to @p styleString.
+     * Does not allocate for strings of up to 64 UTF-16 code units without
+     * surrogates or characters whose lower case expands (U+0130); those
+     * take the reference() path.
+     */
+    int weight(const QString &styleString) const;
+
+    /**
+     * A verbatim copy of getFontWeight() from the Qt 5.12 patch, to verify
+     * and benchmark weight() against.
+     */
+    static int reference(const QString &styleString);
+
+private:
+    FontWeightMapper();
+
+    int lowercasedWeight(const ushort *s, int length) const;
+
+    // the translated keywords, lowercased for the == and contains() tests ...
+    QString m_bold, m_light, m_semiLight, m_book, m_extra, m_demi, m_semi;
+    // ... and case-folded for the QString::compare(Qt::CaseInsensitive) tests
+    QString m_normal, m_regular, m_demiBold, m_semiBold, m_medium,
+        m_black, m_heavy, m_thin, m_extraLight, m_extraBold;
+};
+
+#endif // FONTWEIGHTMAPPER_H
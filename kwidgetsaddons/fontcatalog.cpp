@@ -0,0 +1,388 @@
+/*
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "fontcatalog_p.h"
+
+#include <QCoreApplication>
+#include <QGuiApplication>
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <QThread>
+
+FontCatalog *FontCatalog::instance()
+{
+    // C++11 guarantees thread-safe initialisation of the static local.
+    static FontCatalog *catalog = new FontCatalog;
+    return catalog;
+}
+
+FontCatalog::FontCatalog()
+    : QObject(nullptr)
+{
+    if (QCoreApplication *app = QCoreApplication::instance()) {
+        // the first user may well be a worker thread
+        if (thread() != app->thread()) {
+            moveToThread(app->thread());
+        }
+        // the disk cache writer queries the font database and the platform
+        // plugin, which go away with the application
+        connect(app, &QCoreApplication::aboutToQuit, this, &FontCatalog::stopDiskCacheWriter);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+        // Qt emits this with its font database lock held, and a direct
+        // connection makes invalidate() take m_lock inside it. That is safe
+        // because the catalog never waits for the database with m_lock held.
+        if (QGuiApplication *guiApp = qobject_cast<QGuiApplication *>(app)) {
+            connect(guiApp, &QGuiApplication::fontDatabaseChanged, this, &FontCatalog::invalidate);
+        }
+#endif
+    }
+}
+
+quint64 FontCatalog::generation() const
+{
+    QMutexLocker locker(&m_lock);
+    return m_generation;
+}
+
+void FontCatalog::invalidate()
+{
+    {
+        QMutexLocker locker(&m_lock);
+        m_familiesLoaded = false;
+        m_families.clear();
+        m_familyRows.clear();
+        m_capabilitiesLoaded = false;
+        m_capabilities.clear();
+        m_writingSystems.clear();
+        m_familyInfo.clear();
+        // the snapshot on disk only describes the fonts at startup
+        m_diskCacheState = DiskCacheUnusable;
+        m_generation += 1;
+    }
+    if (QThread::currentThread() == thread()) {
+        emit changed();
+    } else {
+        QMetaObject::invokeMethod(this, "changed", Qt::QueuedConnection);
+    }
+}
+
+// QFontDatabase serialises its callers on a process-wide lock, which it
+// holds while it emits fontDatabaseChanged. Every query therefore runs with
+// m_lock released; what it returns is only kept if the snapshot was not
+// invalidated meanwhile.
+template<typename T, typename Query>
+bool FontCatalog::queryUnlocked(QMutexLocker &locker, T *result, Query query) const
+{
+    const quint64 generation = m_generation;
+    locker.unlock();
+    *result = query();
+    locker.relock();
+    return m_generation == generation;
+}
+
+void FontCatalog::ensureFamilies(QMutexLocker &locker) const
+{
+    if (!m_familiesLoaded && m_diskCacheState == DiskCacheUnknown) {
+        if (!diskCacheEnabled()) {
+            m_diskCacheState = DiskCacheUnusable;
+        } else {
+            // The key of the file walks the font directories. Other callers
+            // query the database in the meantime instead of waiting for it.
+            m_diskCacheState = DiskCacheLoading;
+            Snapshot snapshot;
+            bool loaded;
+            queryUnlocked(locker, &loaded, [&snapshot]() { return loadDiskCache(&snapshot); });
+            // invalidate() makes the file unusable
+            if (m_diskCacheState == DiskCacheLoading) {
+                if (loaded) {
+                    setFamilies(snapshot.families);
+                    m_capabilities = snapshot.capabilities;
+                    m_writingSystems = snapshot.writingSystems;
+                    m_capabilitiesLoaded = true;
+                    m_familyInfo = snapshot.familyInfo;
+                    m_diskCacheState = DiskCacheLoaded;
+                } else {
+                    // complete the snapshot in the background and save it for next time
+                    m_diskCacheState = DiskCacheWriting;
+                    startDiskCacheWriter();
+                }
+            }
+        }
+    }
+    while (!m_familiesLoaded) {
+        QStringList families;
+        if (queryUnlocked(locker, &families, [this]() { return m_db.families(); }) && !m_familiesLoaded) {
+            setFamilies(families);
+        }
+    }
+}
+
+// Filtering the family list asked the database about every family again
+// for each flag and each filter. All families are classified in one pass
+// instead, so that any combination of filters is a scan over bit masks.
+// QFontDatabase serialises its callers on a process-wide lock, so the pass
+// is not split across threads; the chooser runs it off the GUI thread. It
+// runs without m_lock, so that the other catalog calls go on meanwhile.
+void FontCatalog::ensureCapabilities(QMutexLocker &locker) const
+{
+    for (;;) {
+        ensureFamilies(locker);
+        if (m_capabilitiesLoaded) {
+            return;
+        }
+        const QStringList families = m_families;
+        QVector<uint> capabilities(families.size());
+        QVector<quint64> writingSystems(families.size());
+        const auto query = [this, &families, &capabilities, &writingSystems]() {
+            for (int i = 0; i < families.size(); ++i) {
+                const QString &family = families.at(i);
+                uint flags = 0;
+                if (m_db.isFixedPitch(family)) {
+                    flags |= FixedPitch;
+                }
+                if (m_db.isBitmapScalable(family)) {
+                    flags |= BitmapScalable;
+                }
+                if (m_db.isSmoothlyScalable(family)) {
+                    flags |= SmoothlyScalable;
+                }
+                if (!(flags & (BitmapScalable | SmoothlyScalable))) {
+                    flags |= BitmapOnly;
+                }
+                capabilities[i] = flags;
+
+                quint64 familyWritingSystems = 0;
+                const QList<QFontDatabase::WritingSystem> supported = m_db.writingSystems(family);
+                for (QFontDatabase::WritingSystem writingSystem : supported) {
+                    if (writingSystem > QFontDatabase::Any && writingSystem < 64) {
+                        familyWritingSystems |= Q_UINT64_C(1) << writingSystem;
+                    }
+                }
+                writingSystems[i] = familyWritingSystems;
+            }
+            return true;
+        };
+        bool classified;
+        if (queryUnlocked(locker, &classified, query) && !m_capabilitiesLoaded) {
+            m_capabilities.swap(capabilities);
+            m_writingSystems.swap(writingSystems);
+            m_capabilitiesLoaded = true;
+            return;
+        }
+    }
+}
+
+void FontCatalog::setFamilies(const QStringList &families) const
+{
+    m_families = families;
+    m_familyRows.clear();
+    m_familyRows.reserve(m_families.size());
+    for (int i = 0; i < m_families.size(); ++i) {
+        m_familyRows.insert(m_families.at(i), i);
+    }
+    m_familiesLoaded = true;
+}
+
+FontCatalog::FamilyInfo &FontCatalog::familyInfo(QMutexLocker &locker, const QString &family) const
+{
+    for (;;) {
+        // may bring in all family information from the disk cache
+        ensureFamilies(locker);
+        auto it = m_familyInfo.find(family);
+        if (it != m_familyInfo.end()) {
+            return it.value();
+        }
+        FamilyInfo info;
+        const auto query = [this, &family]() {
+            FamilyInfo queried;
+            queried.styles = m_db.styles(family);
+            queried.fixedPitch = m_db.isFixedPitch(family);
+            queried.bitmapScalable = m_db.isBitmapScalable(family);
+            queried.smoothlyScalable = m_db.isSmoothlyScalable(family);
+            return queried;
+        };
+        if (queryUnlocked(locker, &info, query) && !m_familyInfo.contains(family)) {
+            return m_familyInfo.insert(family, info).value();
+        }
+    }
+}
+
+FontCatalog::StyleInfo &FontCatalog::styleInfo(QMutexLocker &locker, const QString &family, const QString &style) const
+{
+    for (;;) {
+        QHash<QString, StyleInfo> &styles = familyInfo(locker, family).styleInfo;
+        auto it = styles.find(style);
+        if (it != styles.end()) {
+            return it.value();
+        }
+        bool smoothlyScalable;
+        const auto query = [this, &family, &style]() { return m_db.isSmoothlyScalable(family, style); };
+        if (queryUnlocked(locker, &smoothlyScalable, query)) {
+            // the family is still there as long as the generation is the same
+            QHash<QString, StyleInfo> &current = m_familyInfo[family].styleInfo;
+            if (!current.contains(style)) {
+                StyleInfo sInfo;
+                sInfo.smoothlyScalable = smoothlyScalable;
+                return current.insert(style, sInfo).value();
+            }
+        }
+    }
+}
+
+QStringList FontCatalog::families() const
+{
+    QMutexLocker locker(&m_lock);
+    ensureFamilies(locker);
+    return m_families;
+}
+
+QStringList FontCatalog::families(uint capabilities, QFontDatabase::WritingSystem writingSystem) const
+{
+    QMutexLocker locker(&m_lock);
+    if (!capabilities && writingSystem == QFontDatabase::Any) {
+        ensureFamilies(locker);
+        return m_families;
+    }
+    ensureCapabilities(locker);
+    const quint64 writingSystemBit = writingSystem == QFontDatabase::Any ? 0 : Q_UINT64_C(1) << writingSystem;
+    QStringList families;
+    for (int i = 0; i < m_families.size(); ++i) {
+        if ((m_capabilities.at(i) & capabilities) == capabilities
+                && (m_writingSystems.at(i) & writingSystemBit) == writingSystemBit) {
+            families.append(m_families.at(i));
+        }
+    }
+    return families;
+}
+
+uint FontCatalog::capabilities(const QString &family) const
+{
+    QMutexLocker locker(&m_lock);
+    ensureCapabilities(locker);
+    return m_capabilities.value(m_familyRows.value(family, -1));
+}
+
+bool FontCatalog::hasFamily(const QString &family) const
+{
+    QMutexLocker locker(&m_lock);
+    ensureFamilies(locker);
+    return m_familyRows.contains(family);
+}
+
+QStringList FontCatalog::styles(const QString &family) const
+{
+    QMutexLocker locker(&m_lock);
+    return familyInfo(locker, family).styles;
+}
+
+bool FontCatalog::isFixedPitch(const QString &family) const
+{
+    QMutexLocker locker(&m_lock);
+    return familyInfo(locker, family).fixedPitch;
+}
+
+bool FontCatalog::isBitmapScalable(const QString &family) const
+{
+    QMutexLocker locker(&m_lock);
+    return familyInfo(locker, family).bitmapScalable;
+}
+
+bool FontCatalog::isSmoothlyScalable(const QString &family) const
+{
+    QMutexLocker locker(&m_lock);
+    return familyInfo(locker, family).smoothlyScalable;
+}
+
+bool FontCatalog::isSmoothlyScalable(const QString &family, const QString &style) const
+{
+    QMutexLocker locker(&m_lock);
+    return styleInfo(locker, family, style).smoothlyScalable;
+}
+
+QList<int> FontCatalog::smoothSizes(const QString &family, const QString &style) const
+{
+    QMutexLocker locker(&m_lock);
+    for (;;) {
+        const StyleInfo &info = styleInfo(locker, family, style);
+        if (info.sizesLoaded) {
+            return info.smoothSizes;
+        }
+        QList<int> sizes;
+        const auto query = [this, &family, &style]() { return m_db.smoothSizes(family, style); };
+        if (queryUnlocked(locker, &sizes, query)) {
+            StyleInfo &current = m_familyInfo[family].styleInfo[style];
+            current.smoothSizes = sizes;
+            current.sizesLoaded = true;
+            return sizes;
+        }
+    }
+}
+
+int FontCatalog::weight(const QString &family, const QString &style) const
+{
+    QMutexLocker locker(&m_lock);
+    for (;;) {
+        const StyleInfo &info = styleInfo(locker, family, style);
+        if (info.weight >= 0) {
+            return info.weight;
+        }
+        int weight;
+        const auto query = [this, &family, &style]() { return m_db.weight(family, style); };
+        if (queryUnlocked(locker, &weight, query)) {
+            m_familyInfo[family].styleInfo[style].weight = weight;
+            return weight;
+        }
+    }
+}
+
+QFont FontCatalog::font(const QString &family, const QString &style, int pointSize) const
+{
+    return m_db.font(family, style, pointSize);
+}
+
+QString FontCatalog::styleString(const QFont &font) const
+{
+    return m_db.styleString(font);
+}
+
+void FontCatalog::applicationFontsChanged()
+{
+    // from Qt 5.11 on, QGuiApplication::fontDatabaseChanged invalidates the
+    // snapshot; the catalog has to exist before the change to receive it
+#if QT_VERSION < QT_VERSION_CHECK(5, 11, 0)
+    invalidate();
+#endif
+}
+
+int FontCatalog::addApplicationFont(const QString &fileName)
+{
+    FontCatalog *catalog = instance();
+    const int id = QFontDatabase::addApplicationFont(fileName);
+    if (id >= 0) {
+        catalog->applicationFontsChanged();
+    }
+    return id;
+}
+
+int FontCatalog::addApplicationFontFromData(const QByteArray &fontData)
+{
+    FontCatalog *catalog = instance();
+    const int id = QFontDatabase::addApplicationFontFromData(fontData);
+    if (id >= 0) {
+        catalog->applicationFontsChanged();
+    }
+    return id;
+}
+
+bool FontCatalog::removeApplicationFont(int id)
+{
+    FontCatalog *catalog = instance();
+    const bool removed = QFontDatabase::removeApplicationFont(id);
+    if (removed) {
+        catalog->applicationFontsChanged();
+    }
+    return removed;
+}
+
+#include "moc_fontcatalog_p.cpp"
@@ -0,0 +1,172 @@
+/*
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+#ifndef FONTCATALOG_P_H
+#define FONTCATALOG_P_H
+
+// Process-wide snapshot of the font database, shared by the KFont* widgets
+// and the test dialog.
+
+#include <QObject>
+#include <QFont>
+#include <QFontDatabase>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+
+/**
+  * @internal
+  *
+  * Caches what the widgets ask QFontDatabase over and over again: the
+  * family list, the styles of each family, the scalability and fixed-pitch
+  * flags and the available sizes of bitmap fonts. Family information is
+  * collected lazily, on first request.
+  *
+  * The snapshot is dropped when the application font set changes (use the
+  * addApplicationFont() wrappers below, or invalidate() after changing the
+  * database behind Qt's back). Each rebuild increments generation(), which
+  * dependent caches can compare against.
+  *
+  * The complete snapshot of the system fonts is also kept on disk, see
+  * fontcatalogcache.cpp, so that later runs start with it instead of
+  * querying the database family by family.
+  *
+  * All methods can be called from any thread.
+  */
+class FontCatalog : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Per-family flags, see capabilities().
+     */
+    enum Capability {
+        FixedPitch = 0x01,
+        BitmapScalable = 0x02,
+        SmoothlyScalable = 0x04,
+        BitmapOnly = 0x08,      ///< neither bitmap nor smoothly scalable
+    };
+
+    static FontCatalog *instance();
+
+    /**
+     * @return a counter that changes every time the snapshot is invalidated
+     */
+    quint64 generation() const;
+
+    QStringList families() const;
+
+    /**
+     * @return the families that have all of the @p capabilities (Capability
+     * flags) and support @p writingSystem, in the order of families()
+     */
+    QStringList families(uint capabilities, QFontDatabase::WritingSystem writingSystem = QFontDatabase::Any) const;
+
+    /**
+     * @return the Capability flags of @p family, 0 for unknown families
+     */
+    uint capabilities(const QString &family) const;
+
+    bool hasFamily(const QString &family) const;
+    QStringList styles(const QString &family) const;
+    bool isFixedPitch(const QString &family) const;
+    bool isBitmapScalable(const QString &family) const;
+    bool isSmoothlyScalable(const QString &family) const;
+    bool isSmoothlyScalable(const QString &family, const QString &style) const;
+    QList<int> smoothSizes(const QString &family, const QString &style) const;
+    int weight(const QString &family, const QString &style) const;
+
+    /**
+     * Pass-throughs to the shared QFontDatabase instance.
+     */
+    QFont font(const QString &family, const QString &style, int pointSize) const;
+    QString styleString(const QFont &font) const;
+
+    /**
+     * Wrappers for the QFontDatabase functions of the same name that make
+     * sure the snapshot is invalidated, also before Qt 5.11.
+     */
+    static int addApplicationFont(const QString &fileName);
+    static int addApplicationFontFromData(const QByteArray &fontData);
+    static bool removeApplicationFont(int id);
+
+public Q_SLOTS:
+    void invalidate();
+
+Q_SIGNALS:
+    /**
+     * Emitted (in the GUI thread) after the snapshot has been invalidated.
+     */
+    void changed();
+
+private:
+    FontCatalog();
+
+    struct StyleInfo {
+        bool smoothlyScalable = false;
+        bool sizesLoaded = false;
+        QList<int> smoothSizes;
+        int weight = -1;        // -1 until loaded
+    };
+    struct FamilyInfo {
+        QStringList styles;
+        bool fixedPitch = false;
+        bool bitmapScalable = false;
+        bool smoothlyScalable = false;
+        QHash<QString, StyleInfo> styleInfo;
+    };
+
+    // All of these require m_lock to be held by the locker, and release it
+    // while they query the database. References stay valid until then.
+    template<typename T, typename Query>
+    bool queryUnlocked(QMutexLocker &locker, T *result, Query query) const;
+    void ensureFamilies(QMutexLocker &locker) const;
+    void ensureCapabilities(QMutexLocker &locker) const;
+    void setFamilies(const QStringList &families) const;
+    FamilyInfo &familyInfo(QMutexLocker &locker, const QString &family) const;
+    StyleInfo &styleInfo(QMutexLocker &locker, const QString &family, const QString &style) const;
+    void applicationFontsChanged();
+
+    // the on-disk copy of the snapshot, in fontcatalogcache.cpp
+    enum DiskCacheState {
+        DiskCacheUnknown,
+        DiskCacheLoading,
+        DiskCacheLoaded,
+        DiskCacheWriting,
+        DiskCacheUnusable      // disabled, or the fonts changed during this run
+    };
+    struct Snapshot {
+        QStringList families;
+        QVector<uint> capabilities;
+        QVector<quint64> writingSystems;
+        QHash<QString, FamilyInfo> familyInfo;
+    };
+    class DiskCacheWriter;
+    static bool diskCacheEnabled();
+    static bool loadDiskCache(Snapshot *snapshot);   // without m_lock
+    void startDiskCacheWriter() const;  // requires m_lock
+    void writeDiskCache(quint64 generation);
+    void stopDiskCacheWriter();
+
+    mutable QMutex m_lock;
+    mutable QFontDatabase m_db;
+    mutable bool m_familiesLoaded = false;
+    mutable QStringList m_families;
+    mutable QHash<QString, int> m_familyRows;      // family -> index in m_families
+    // parallel to m_families, computed for all families at once
+    mutable bool m_capabilitiesLoaded = false;
+    mutable QVector<uint> m_capabilities;
+    mutable QVector<quint64> m_writingSystems;     // bit n: QFontDatabase::WritingSystem n
+    mutable QHash<QString, FamilyInfo> m_familyInfo;
+    mutable DiskCacheState m_diskCacheState = DiskCacheUnknown;
+    mutable QThreadPool m_diskCachePool;
+    QAtomicInt m_diskCacheStopped;
+    quint64 m_generation = 0;
+};
+
+#endif
@@ -0,0 +1,227 @@
+/*
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+// The on-disk copy of the FontCatalog snapshot.
+//
+// A run that finds no usable copy completes the snapshot of all system
+// families on a worker thread and saves it; the worker stops early when the
+// application quits, which waits for it. Later runs map the file and
+// read the snapshot back in one go, as long as the key still matches: the
+// Qt version, the platform plugin, the locale and the modification times
+// of the font directories and of the fontconfig configuration.
+
+#include "fontcatalog_p.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QLocale>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <QDebug>
+
+#include <climits>
+
+static const quint32 DiskCacheMagic = 0x46574943;   // "FWIC"
+// Increment when the layout written by writeDiskCache() changes.
+static const quint32 DiskCacheVersion = 1;
+
+static QString diskCacheFileName()
+{
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    return dir.isEmpty() ? QString() : dir + QStringLiteral("/fontcatalog.cache");
+}
+
+static QByteArray diskCacheKey()
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(qVersion());
+    hash.addData(QGuiApplication::platformName().toUtf8());
+    // style names come translated from QFontDatabase
+    hash.addData(QLocale().name().toUtf8());
+    hash.addData(QCoreApplication::translate("QFontDatabase", "Bold").toUtf8());
+    hash.addData(QCoreApplication::translate("QFontDatabase", "Italic").toUtf8());
+
+    QStringList dirs = QStandardPaths::standardLocations(QStandardPaths::FontsLocation);
+#if defined(Q_OS_UNIX) && !defined(Q_OS_DARWIN)
+    dirs << QStringLiteral("/usr/share/fonts") << QStringLiteral("/usr/local/share/fonts")
+         << QDir::homePath() + QStringLiteral("/.fonts") << QStringLiteral("/etc/fonts");
+#endif
+    dirs.removeDuplicates();
+    // Adding or removing a file changes the modification time of its
+    // directory, so the directories are enough.
+    for (const QString &dir : qAsConst(dirs)) {
+        const QFileInfo info(dir);
+        if (!info.isDir()) {
+            continue;
+        }
+        hash.addData(dir.toUtf8());
+        hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+        QDirIterator it(dir, QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            it.next();
+            hash.addData(it.filePath().toUtf8());
+            hash.addData(QByteArray::number(it.fileInfo().lastModified().toMSecsSinceEpoch()));
+        }
+    }
+    return hash.result();
+}
+
+bool FontCatalog::diskCacheEnabled()
+{
+    return qEnvironmentVariableIsEmpty("FONTCATALOG_NO_DISK_CACHE") && QCoreApplication::instance()
+           && !diskCacheFileName().isEmpty();
+}
+
+bool FontCatalog::loadDiskCache(Snapshot *snapshot)
+{
+    QFile file(diskCacheFileName());
+    if (!file.open(QIODevice::ReadOnly) || file.size() <= 0 || file.size() > INT_MAX) {
+        return false;
+    }
+    // Only what is read from the mapping is copied; the mapping goes away
+    // with the QFile.
+    const uchar *address = file.map(0, file.size());
+    const QByteArray contents = address
+                                ? QByteArray::fromRawData(reinterpret_cast<const char *>(address), int(file.size()))
+                                : file.readAll();
+    QDataStream stream(contents);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic, version;
+    QByteArray key;
+    stream >> magic >> version >> key;
+    if (stream.status() != QDataStream::Ok || magic != DiskCacheMagic || version != DiskCacheVersion
+            || key != diskCacheKey()) {
+        return false;
+    }
+
+    Snapshot loaded;
+    quint32 familyCount;
+    stream >> familyCount;
+    for (quint32 i = 0; i < familyCount && stream.status() == QDataStream::Ok; ++i) {
+        QString family;
+        quint32 flags;
+        quint64 familyWritingSystems;
+        FamilyInfo info;
+        stream >> family >> flags >> familyWritingSystems >> info.styles;
+        info.fixedPitch = flags & FixedPitch;
+        info.bitmapScalable = flags & BitmapScalable;
+        info.smoothlyScalable = flags & SmoothlyScalable;
+        for (const QString &style : qAsConst(info.styles)) {
+            StyleInfo styleInfo;
+            qint32 weight;
+            stream >> styleInfo.smoothlyScalable >> weight >> styleInfo.sizesLoaded >> styleInfo.smoothSizes;
+            styleInfo.weight = weight;
+            info.styleInfo.insert(style, styleInfo);
+        }
+        loaded.families.append(family);
+        loaded.capabilities.append(flags);
+        loaded.writingSystems.append(familyWritingSystems);
+        loaded.familyInfo.insert(family, info);
+    }
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "Ignoring the truncated font catalog cache" << file.fileName();
+        return false;
+    }
+
+    *snapshot = loaded;
+    return true;
+}
+
+class FontCatalog::DiskCacheWriter : public QRunnable
+{
+public:
+    explicit DiskCacheWriter(quint64 generation)
+        : generation(generation)
+    {}
+
+    void run() override
+    {
+        FontCatalog::instance()->writeDiskCache(generation);
+    }
+
+private:
+    quint64 generation;
+};
+
+void FontCatalog::startDiskCacheWriter() const
+{
+    m_diskCachePool.setMaxThreadCount(1);
+    m_diskCachePool.start(new DiskCacheWriter(m_generation));
+}
+
+void FontCatalog::stopDiskCacheWriter()
+{
+    m_diskCacheStopped.storeRelease(1);
+    m_diskCachePool.waitForDone();
+}
+
+void FontCatalog::writeDiskCache(quint64 generation)
+{
+    // Fill in the snapshot through the public methods, which lets the GUI
+    // thread in between the families.
+    const QStringList families = this->families();
+    for (const QString &family : families) {
+        if (m_diskCacheStopped.loadAcquire()) {
+            return;
+        }
+        for (const QString &style : styles(family)) {
+            if (!isSmoothlyScalable(family, style)) {
+                smoothSizes(family, style);
+            }
+            weight(family, style);
+        }
+    }
+    if (m_diskCacheStopped.loadAcquire()) {
+        return;
+    }
+    const QByteArray key = diskCacheKey();
+
+    Snapshot snapshot;
+    {
+        QMutexLocker locker(&m_lock);
+        // releases m_lock while it classifies the families
+        ensureCapabilities(locker);
+        // Application fonts or font changes invalidate the snapshot; it
+        // would not describe the system fonts alone any more.
+        if (m_generation != generation || m_diskCacheState != DiskCacheWriting) {
+            return;
+        }
+        snapshot.families = m_families;
+        snapshot.capabilities = m_capabilities;
+        snapshot.writingSystems = m_writingSystems;
+        snapshot.familyInfo = m_familyInfo;
+    }
+
+    QByteArray contents;
+    QDataStream stream(&contents, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << DiskCacheMagic << DiskCacheVersion << key << quint32(snapshot.families.size());
+    for (int i = 0; i < snapshot.families.size(); ++i) {
+        const QString &family = snapshot.families.at(i);
+        const FamilyInfo info = snapshot.familyInfo.value(family);
+        stream << family << quint32(snapshot.capabilities.at(i)) << snapshot.writingSystems.at(i) << info.styles;
+        for (const QString &style : info.styles) {
+            const StyleInfo sInfo = info.styleInfo.value(style);
+            stream << sInfo.smoothlyScalable << qint32(sInfo.weight) << sInfo.sizesLoaded << sInfo.smoothSizes;
+        }
+    }
+
+    const QString fileName = diskCacheFileName();
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(contents) != contents.size() || !file.commit()) {
+        qWarning() << "Cannot write the font catalog cache" << fileName << ":" << file.errorString();
+    }
+}
@@ -6,7 +6,21 @@
 
 #include "fonthelpers_p.h"
 
+#include <QCollator>
+#include <QCollatorSortKey>
 #include <QCoreApplication>
+#include <QEvent>
+#include <QLocale>
+#include <QMetaObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QSharedPointer>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <vector>
 
 #ifdef NEVERDEFINE // never true
 // Font names up for translation, listed for extraction.
@@ -72,9 +86,158 @@ QString translateFontName(const QString &name)
     return trfont;
 }
 
-static bool localeLessThan(const QString &a, const QString &b)
+namespace {
+
+// Translating a family takes two UTF-8 conversions and up to three
+// catalog lookups; the translations are kept per raw name instead.
+// The generic names and the "%1" filters are what translators are meant
+// to translate, so their translations tell whether the cache is still
+// current. translateFontName() looks up every family and foundry though,
+// and a translator may translate real family names too, so the cache is
+// also dropped when the application's translators change (QEvent::
+// LanguageChange).
+class TranslationCache : public QObject
+{
+public:
+    TranslationCache()
+    {
+        if (QCoreApplication *app = QCoreApplication::instance()) {
+            // the first user may be a worker thread; the filter has to live
+            // in the application's thread
+            moveToThread(app->thread());
+            QMetaObject::invokeMethod(app, [this, app]() {
+                app->installEventFilter(this);
+            });
+        }
+    }
+
+    bool eventFilter(QObject *watched, QEvent *event) override
+    {
+        if (event->type() == QEvent::LanguageChange && watched == QCoreApplication::instance()) {
+            QMutexLocker locker(&lock);
+            translations.clear();
+            fingerprint.clear();
+        }
+        return false;
+    }
+
+    QMutex lock;
+    QHash<QString, QString> translations;
+    QStringList fingerprint;
+};
+
+QStringList translationFingerprint(const QStringList &genericNames)
+{
+    QStringList fingerprint {
+        QLocale().name(),
+        QCoreApplication::translate("FontHelpers", "%1", "@item Font name"),
+        QCoreApplication::translate("FontHelpers", "%1 [%2]", "@item Font name [foundry]"),
+    };
+    for (const QString &genericName : genericNames) {
+        fingerprint.append(QCoreApplication::translate("FontHelpers", genericName.toUtf8().constData(), "@item Font name"));
+    }
+    return fingerprint;
+}
+
+// A translated name with its collation key. Names that collate equally
+// are ordered by code points, std::sort() with localeAwareCompare() left
+// their order unspecified.
+struct SortEntry {
+    SortEntry(const QCollatorSortKey &key, const QString &name)
+        : key(key)
+        , name(name)
+    {}
+    QCollatorSortKey key;
+    QString name;
+};
+
+bool operator<(const SortEntry &a, const SortEntry &b)
 {
-    return QString::localeAwareCompare(a, b) < 0;
+    const int result = a.key.compare(b.key);
+    return result < 0 || (result == 0 && a.name < b.name);
+}
+
+// Below this many names the thread hand-over costs more than it saves.
+const int ParallelSortMinimum = 4096;
+
+// The parts of a list sorted in parallel. The thread calling
+// translateFontNameList() takes parts itself too, so the sort completes
+// even when the thread pool is busy (the chooser calls it from the pool).
+struct ParallelSort {
+    QLocale locale;
+    std::vector<std::vector<SortEntry> > sortedParts;
+    QStringList names;
+    QAtomicInt nextPart;
+    QSemaphore partsDone;
+
+    void sortParts()
+    {
+        const int partCount = int(sortedParts.size());
+        int part;
+        while ((part = nextPart.fetchAndAddRelaxed(1)) < partCount) {
+            QCollator collator(locale);
+            const int begin = int(qint64(names.size()) * part / partCount);
+            const int end = int(qint64(names.size()) * (part + 1) / partCount);
+            std::vector<SortEntry> &entries = sortedParts[part];
+            entries.reserve(end - begin);
+            for (int i = begin; i < end; ++i) {
+                entries.emplace_back(collator.sortKey(names.at(i)), names.at(i));
+            }
+            std::sort(entries.begin(), entries.end());
+            partsDone.release();
+        }
+    }
+};
+
+class SortRunnable : public QRunnable
+{
+public:
+    explicit SortRunnable(const QSharedPointer<ParallelSort> &sort)
+        : sort(sort)
+    {}
+
+    void run() override
+    {
+        sort->sortParts();
+    }
+
+private:
+    QSharedPointer<ParallelSort> sort;
+};
+
+}
+
+Q_GLOBAL_STATIC(TranslationCache, translationCache)
+
+// Sort locale-aware, like QString::localeAwareCompare() does: that uses
+// a QCollator for the default locale, here each name is transformed into
+// a collation key once instead of on every comparison.
+static void sortLocaleAware(QStringList &names)
+{
+    QThreadPool *pool = QThreadPool::globalInstance();
+    const int partCount = names.size() < ParallelSortMinimum ? 1
+                        : qBound(1, qMin(pool->maxThreadCount(), names.size() / (ParallelSortMinimum / 2)), 16);
+
+    QSharedPointer<ParallelSort> sort(new ParallelSort);
+    sort->names = names;
+    sort->sortedParts.resize(partCount);
+    for (int i = 1; i < partCount; ++i) {
+        pool->start(new SortRunnable(sort));
+    }
+    sort->sortParts();
+    sort->partsDone.acquire(partCount);
+
+    std::vector<SortEntry> entries = std::move(sort->sortedParts[0]);
+    for (int part = 1; part < partCount; ++part) {
+        std::vector<SortEntry> &sortedPart = sort->sortedParts[part];
+        const auto middle = entries.insert(entries.end(), sortedPart.begin(), sortedPart.end());
+        std::inplace_merge(entries.begin(), middle, entries.end());
+        sortedPart.clear();
+    }
+
+    for (int i = 0; i < int(entries.size()); ++i) {
+        names[i] = entries[i].name;
+    }
 }
 
 QStringList translateFontNameList(const QStringList &names,
@@ -87,23 +250,45 @@ QStringList translateFontNameList(const QStringList &names,
         QStringLiteral("Sans Serif"),
     };
 
+    TranslationCache *cache = translationCache();
+    const QStringList fingerprint = translationFingerprint(genericNames);
+
     // Translate fonts, but do not add generics to the list right away.
     QStringList trNames;
+    QStringList trGenericNames;
     QHash<QString, QString> trMap;
-    for (const QString &name : names) {
-        const QString trName = translateFontName(name);
-        if (!genericNames.contains(name)) {
-            trNames.append(trName);
+    trNames.reserve(names.size());
+    trMap.reserve(names.size());
+    {
+        QMutexLocker locker(&cache->lock);
+        if (cache->fingerprint != fingerprint) {
+            cache->translations.clear();
+            cache->fingerprint = fingerprint;
+        }
+        for (const QString &genericName : genericNames) {
+            auto it = cache->translations.constFind(genericName);
+            if (it == cache->translations.constEnd()) {
+                it = cache->translations.insert(genericName, translateFontName(genericName));
+            }
+            trGenericNames.append(it.value());
+        }
+        for (const QString &name : names) {
+            auto it = cache->translations.constFind(name);
+            if (it == cache->translations.constEnd()) {
+                it = cache->translations.insert(name, translateFontName(name));
+            }
+            if (!genericNames.contains(name)) {
+                trNames.append(it.value());
+            }
+            trMap.insert(it.value(), name);
         }
-        trMap.insert(trName, name);
     }
 
     // Sort real fonts alphabetically.
-    std::sort(trNames.begin(), trNames.end(), localeLessThan);
+    sortLocaleAware(trNames);
 
     // Prepend generic fonts, in the predefined order.
-    for (const QString &genericName : genericNames) {
-        const QString trGenericName = translateFontName(genericName);
+    for (const QString &trGenericName : qAsConst(trGenericNames)) {
         if (trMap.contains(trGenericName)) {
             trNames.prepend(trGenericName);
         }
@@ -0,0 +1,133 @@
+/*
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "fontnamelistmodel_p.h"
+
+#include <algorithm>
+
+FontNameListModel::FontNameListModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+}
+
+int FontNameListModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_texts.size();
+}
+
+QVariant FontNameListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_texts.size()) {
+        return QVariant();
+    }
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::EditRole:
+        return m_texts.at(index.row());
+    default:
+        return QVariant();
+    }
+}
+
+void FontNameListModel::setNames(const QStringList &texts, const QStringList &rawNames)
+{
+    beginResetModel();
+    m_texts.clear();
+    m_rawNames.clear();
+    m_foldedNames.clear();
+    m_foldedRows.clear();
+    m_texts.reserve(texts.size());
+    m_rawNames.reserve(texts.size());
+    m_foldedNames.reserve(texts.size());
+    m_foldedRows.reserve(texts.size());
+    appendRows(texts, rawNames);
+    endResetModel();
+}
+
+void FontNameListModel::append(const QStringList &texts, const QStringList &rawNames)
+{
+    if (texts.isEmpty()) {
+        return;
+    }
+    const int first = m_texts.size();
+    beginInsertRows(QModelIndex(), first, first + texts.size() - 1);
+    appendRows(texts, rawNames);
+    endInsertRows();
+}
+
+void FontNameListModel::appendRows(const QStringList &texts, const QStringList &rawNames)
+{
+    for (int i = 0; i < texts.size(); ++i) {
+        const QString &raw = rawNames.isEmpty() ? texts.at(i) : rawNames.at(i);
+        const QString folded = raw.toCaseFolded();
+        if (!m_foldedRows.contains(folded)) {
+            m_foldedRows.insert(folded, m_texts.size());
+        }
+        m_texts.append(texts.at(i));
+        m_rawNames.append(raw);
+        m_foldedNames.append(folded);
+    }
+    m_prefixOrder.clear();
+}
+
+void FontNameListModel::clear()
+{
+    beginResetModel();
+    m_texts.clear();
+    m_rawNames.clear();
+    m_foldedNames.clear();
+    m_foldedRows.clear();
+    m_prefixOrder.clear();
+    endResetModel();
+}
+
+void FontNameListModel::setText(int row, const QString &text)
+{
+    if (m_texts.at(row) != text) {
+        m_texts[row] = text;
+        const QModelIndex changed = index(row);
+        emit dataChanged(changed, changed);
+    }
+}
+
+int FontNameListModel::indexOf(const QString &text) const
+{
+    return m_texts.indexOf(text);
+}
+
+int FontNameListModel::findFolded(const QString &folded) const
+{
+    return m_foldedRows.value(folded, -1);
+}
+
+int FontNameListModel::findFoldedPrefix(const QString &prefix) const
+{
+    if (m_foldedNames.isEmpty() || prefix.isEmpty()) {
+        return m_foldedNames.isEmpty() ? -1 : 0;
+    }
+    if (m_prefixOrder.size() != m_foldedNames.size()) {
+        m_prefixOrder.resize(m_foldedNames.size());
+        for (int row = 0; row < m_prefixOrder.size(); ++row) {
+            m_prefixOrder[row] = row;
+        }
+        std::sort(m_prefixOrder.begin(), m_prefixOrder.end(), [this](int a, int b) {
+            return m_foldedNames.at(a) < m_foldedNames.at(b) || (m_foldedNames.at(a) == m_foldedNames.at(b) && a < b);
+        });
+    }
+
+    // The names starting with the prefix follow the first one that does
+    // not sort before it; of these, the list shows the one in the lowest row.
+    auto it = std::lower_bound(m_prefixOrder.constBegin(), m_prefixOrder.constEnd(), prefix, [this](int row, const QString &prefix) {
+        return m_foldedNames.at(row) < prefix;
+    });
+    int first = -1;
+    for (; it != m_prefixOrder.constEnd() && m_foldedNames.at(*it).startsWith(prefix); ++it) {
+        if (first < 0 || *it < first) {
+            first = *it;
+        }
+    }
+    return first;
+}
+
+#include "moc_fontnamelistmodel_p.cpp"
@@ -0,0 +1,89 @@
+/*
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+#ifndef FONTNAMELISTMODEL_P_H
+#define FONTNAMELISTMODEL_P_H
+
+// Flat list model for the family, style and size lists of KFontChooser.
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+
+/**
+  * @internal
+  *
+  * A read-only list of display strings, each with the raw name it stands
+  * for (a family or style as reported by Qt) and the case-folded raw name
+  * for case-insensitive lookups. The three are kept in parallel arrays
+  * instead of one QListWidgetItem per row; combined with
+  * QListView::setUniformItemSizes(true) the view only ever looks at the
+  * rows it shows.
+  */
+class FontNameListModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    explicit FontNameListModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    /**
+     * Replace the contents. When @p rawNames is empty, each display
+     * string is its own raw name; otherwise both lists have the same size.
+     */
+    void setNames(const QStringList &texts, const QStringList &rawNames = QStringList());
+    void append(const QStringList &texts, const QStringList &rawNames = QStringList());
+    void clear();
+
+    QString text(int row) const
+    {
+        return m_texts.at(row);
+    }
+    QString rawName(int row) const
+    {
+        return m_rawNames.at(row);
+    }
+    const QString &foldedName(int row) const
+    {
+        return m_foldedNames.at(row);
+    }
+
+    /**
+     * Change the display string of @p row, keeping its raw name.
+     */
+    void setText(int row, const QString &text);
+
+    /**
+     * @return the first row displaying @p text, or -1
+     */
+    int indexOf(const QString &text) const;
+
+    /**
+     * @return the first row whose case-folded raw name is @p folded, or -1
+     */
+    int findFolded(const QString &folded) const;
+
+    /**
+     * @return the first row whose case-folded raw name starts with
+     * @p prefix, or -1
+     */
+    int findFoldedPrefix(const QString &prefix) const;
+
+private:
+    void appendRows(const QStringList &texts, const QStringList &rawNames);
+
+    QVector<QString> m_texts;
+    QVector<QString> m_rawNames;
+    QVector<QString> m_foldedNames;
+    // first row of each case-folded raw name
+    QHash<QString, int> m_foldedRows;
+    // all rows ordered by their case-folded raw name, so that the names
+    // with a common prefix are adjacent; built on the first prefix lookup
+    mutable QVector<int> m_prefixOrder;
+};
+
+#endif
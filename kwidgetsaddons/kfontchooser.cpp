@@ -8,6 +8,8 @@
 
 #include "kfontchooser.h"
 #include "fonthelpers_p.h"
+#include "fontcatalog_p.h"
+#include "fontnamelistmodel_p.h"
 
 #include <QCheckBox>
 #include <QDoubleSpinBox>
@@ -15,30 +17,55 @@
 #include <QLabel>
 #include <QLayout>
 #include <QLocale>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QSplitter>
 #include <QScrollBar>
 #include <QFontDatabase>
 #include <QGroupBox>
-#include <QListWidget>
+#include <QListView>
+#include <QRunnable>
+#include <QSharedPointer>
 #include <QTextEdit>
+#include <QThreadPool>
+#include <QTimer>
+#include <QVector>
 
+#include <algorithm>
 #include <cmath>
+#include <functional>
 
 // When message extraction needs to be avoided.
 #define TR_NOX tr
 
-static int minimumListWidth(const QListWidget *list)
+static int textWidth(const QFontMetrics &fm, const QString &text)
 {
-    int w = 0;
-    for (int i = 0; i < list->count(); i++) {
-        int itemWidth = list->visualItemRect(list->item(i)).width();
-        // ...and add a space on both sides for not too tight look.
 #if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
-        itemWidth += list->fontMetrics().horizontalAdvance(QLatin1Char(' ')) * 2;
+    return fm.horizontalAdvance(text);
 #else
-        itemWidth += list->fontMetrics().width(QLatin1Char(' ')) * 2;
+    return fm.width(text);
 #endif
-        w = qMax(w, itemWidth);
+}
+
+static int widestTextWidth(const QFontMetrics &fm, const QStringList &texts)
+{
+    int w = 0;
+    for (const QString &text : texts) {
+        w = qMax(w, textWidth(fm, text));
+    }
+    return w;
+}
+
+// The width of a list whose widest row text is @p widestText pixels wide.
+static int listWidthForText(const QListView *list, int widestText)
+{
+    int w = 0;
+    if (widestText > 0) {
+        const QFontMetrics fm = list->fontMetrics();
+        // the item delegate pads the text on both sides
+        const int textMargin = list->style()->pixelMetric(QStyle::PM_FocusFrameHMargin, nullptr, list) + 1;
+        // ...and add a space on both sides for not too tight look.
+        w = widestText + 2 * textMargin + textWidth(fm, QStringLiteral(" ")) * 2;
     }
     if (w == 0) {
         w = 40;
@@ -48,9 +75,70 @@ static int minimumListWidth(const QListWidget *list)
     return w;
 }
 
-static int minimumListHeight(const QListWidget *list, int numVisibleEntry)
+static int minimumListWidth(const QListView *list)
 {
-    int w = list->count() > 0 ? list->visualItemRect(list->item(0)).height() :
+    const QAbstractItemModel *model = list->model();
+    const QFontMetrics fm = list->fontMetrics();
+    int widestText = 0;
+    for (int i = 0; i < model->rowCount(); i++) {
+        widestText = qMax(widestText, textWidth(fm, model->index(i, 0).data().toString()));
+    }
+    return listWidthForText(list, widestText);
+}
+
+// Measuring every family name to size the family list takes a noticeable
+// part of building it, and the result only depends on the family list and
+// the font of the view. It is measured once, on the thread building the
+// list, and shared by all choosers until the font catalog changes.
+namespace {
+class FamilyWidthCache
+{
+public:
+    static QString key(const QFont &font, uint criteria)
+    {
+        return font.key() + QLatin1Char('/') + QString::number(criteria);
+    }
+
+    bool find(quint64 generation, const QString &key, int *width)
+    {
+        QMutexLocker locker(&lock);
+        if (generation != cacheGeneration) {
+            return false;
+        }
+        auto it = widths.constFind(key);
+        if (it == widths.constEnd()) {
+            return false;
+        }
+        *width = it.value();
+        return true;
+    }
+
+    void insert(quint64 generation, const QString &key, int width)
+    {
+        QMutexLocker locker(&lock);
+        if (generation < cacheGeneration) {
+            // measured on a list that is already outdated
+            return;
+        }
+        if (generation > cacheGeneration) {
+            widths.clear();
+            cacheGeneration = generation;
+        }
+        widths.insert(key, width);
+    }
+
+private:
+    QMutex lock;
+    QHash<QString, int> widths;
+    quint64 cacheGeneration = 0;
+};
+}
+
+Q_GLOBAL_STATIC(FamilyWidthCache, familyWidthCache)
+
+static int minimumListHeight(const QListView *list, int numVisibleEntry)
+{
+    int w = list->model()->rowCount() > 0 ? list->sizeHintForRow(0) :
             list->fontMetrics().lineSpacing();
 
     if (w < 0) {
@@ -62,9 +150,59 @@ static int minimumListHeight(const QListWidget *list, int numVisibleEntry)
     return (w * numVisibleEntry + 2 * list->frameWidth());
 }
 
-static QString formatFontSize(qreal size)
+static QString formatFontSize(const QLocale &locale, qreal size)
+{
+    return locale.toString(size, 'f', (size == floor(size)) ? 0 : 1);
+}
+
+// A style of a family that survives the QFontDatabase set/get round trip,
+// see familyRowChosen().
+struct ValidatedStyle {
+    QString style;          // as reported by QFontDatabase
+    QString trStyle;        // as shown in the style list
+    QString identifier;     // see styleIdentifier()
+};
+typedef QVector<ValidatedStyle> ValidatedStyleList;
+
+// The number of families the background builder hands over at a time.
+static const int FamilyChunkSize = 256;
+
+// The family, style and size lists only show a handful of rows at a time.
+static QListView *createListView(FontNameListModel *model, QWidget *parent)
+{
+    QListView *view = new QListView(parent);
+    view->setUniformItemSizes(true);
+    view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    view->setModel(model);
+    return view;
+}
+
+static inline int currentRow(const QListView *view)
+{
+    return view->currentIndex().row();
+}
+
+static inline void setCurrentRow(QListView *view, int row)
+{
+    view->setCurrentIndex(view->model()->index(row, 0));
+}
+
+namespace {
+class FunctionRunnable : public QRunnable
 {
-    return QLocale::system().toString(size, 'f', (size == floor(size)) ? 0 : 1);
+public:
+    explicit FunctionRunnable(const std::function<void()> &function)
+        : function(function)
+    {}
+
+    void run() override
+    {
+        function();
+    }
+
+private:
+    std::function<void()> function;
+};
 }
 
 class Q_DECL_HIDDEN KFontChooser::Private
@@ -80,6 +218,25 @@ public:
         customSizeRow = -1;
     }
 
+    ~Private()
+    {
+        if (familyRequest) {
+            familyRequest->d = nullptr;
+            familyRequest->cancelled.store(1);
+        }
+    }
+
+    // A family list being built in the background. The chunks are delivered
+    // through the event loop; they are dropped once the request has been
+    // superseded by a new one or the chooser has gone away.
+    struct FamilyListRequest {
+        explicit FamilyListRequest(Private *d)
+            : d(d)
+        {}
+        Private *d;             // only used on the GUI thread
+        QAtomicInt cancelled;   // tells the builder to stop early
+    };
+
     // pointer to an optinally supplied list of fonts to
     // inserted into the fontdialog font-family combo-box
 //    QStringList  fontList;
@@ -88,15 +245,23 @@ public:
               int visibleListSize, Qt::CheckState *sizeIsRelativeState);
     void setFamilyBoxItems(const QStringList &fonts);
     void fillFamilyListBox(bool onlyFixedFonts = false);
+    void _k_family_chunk_arrived(const QSharedPointer<FamilyListRequest> &request, const QStringList &families,
+                                 const QStringList &rawFamilies, bool last, int widestText);
+    int familyListWidth() const;
     int nearestSizeRow(qreal val, bool customize);
+    void setSizeRowValue(int row, qreal value, const QString &text);
+    void restoreCustomSizeRow();
     qreal fillSizeList(const QList<qreal> &sizes = QList<qreal>());
     qreal setupSizeListBox(const QString &family, const QString &style);
 
     void setupDisplay();
     QString styleIdentifier(const QFont &font);
+    const ValidatedStyleList &validatedStyles(const QString &family);
+    void prefetchNeighbourStyles();
+    void _k_prefetch_styles();
 
-    void _k_family_chosen_slot(const QString &);
-    void _k_size_chosen_slot(const QString &);
+    void familyRowChosen(int familyRow);
+    void _k_size_chosen_slot(int row);
     void _k_style_chosen_slot(const QString &);
     void _k_displaySample(const QFont &font);
     void _k_size_value_slot(double);
@@ -115,30 +280,48 @@ public:
     QCheckBox    *styleCheckbox = nullptr;
     QCheckBox    *sizeCheckbox = nullptr;
     QLabel       *sizeLabel = nullptr;
-    QListWidget     *familyListBox = nullptr;
-    QListWidget     *styleListBox = nullptr;
-    QListWidget     *sizeListBox = nullptr;
+    QListView       *familyListBox = nullptr;
+    QListView       *styleListBox = nullptr;
+    QListView       *sizeListBox = nullptr;
+    // translated names of the families and styles, with the names Qt uses
+    FontNameListModel *familyModel = nullptr;
+    FontNameListModel *styleModel = nullptr;
+    FontNameListModel *sizeModel = nullptr;
     QCheckBox    *sizeIsRelativeCheckBox = nullptr;
 
     QCheckBox *onlyFixedCheckbox = nullptr;
 
+    QSharedPointer<FamilyListRequest> familyRequest;
+    // pixel width of the widest family name, -1 if not known yet
+    int familyTextWidth = -1;
+    // setFont() was called before the family of its font had arrived
+    bool selectionPending = false;
+
+    // Validates the styles of the families next to the current one
+    // while the event loop is idle.
+    QTimer *prefetchTimer = nullptr;
+    QStringList prefetchQueue;
+
     QFont        selFont;
 
     QString      selectedStyle;
     qreal        selectedSize;
 
+    // The sizes of the rows of the size list, in ascending order, and the
+    // locale they are shown in.
+    QVector<qreal> sizeValues;
+    QLocale      sizeLocale = QLocale::system();
+
     QString      standardSizeAtCustom;
+    qreal        standardSizeValueAtCustom = 0;
     int          customSizeRow;
 
     bool signalsAllowed: 1;
 
     bool usingFixed: 1;
 
-    // Mappings of translated to Qt originated family and style strings.
-    QHash<QString, QString> qtFamilies;
-    QHash<QString, QString> qtStyles;
-    // Mapping of translated style strings to internal style identifiers.
-    QHash<QString, QString> styleIDs;
+    // Internal style identifiers of the rows of the style list.
+    QStringList styleIDs;
 
 };
 
@@ -204,11 +387,14 @@ void KFontChooser::Private::init(const DisplayFlags &flags, const QStringList &f
 
     ++row;
 
-    familyListBox = new QListWidget(page);
+    familyModel = new FontNameListModel(q);
+    familyListBox = createListView(familyModel, page);
     gridLayout->addWidget(familyListBox, row, 0);
 
-    connect(familyListBox, &QListWidget::currentTextChanged, [this](const QString &family) {
-        _k_family_chosen_slot(family);
+    connect(familyListBox->selectionModel(), &QItemSelectionModel::currentChanged, [this](const QModelIndex &current) {
+        if (current.isValid()) {
+            familyRowChosen(current.row());
+        }
     });
 
     if (flags & ShowDifferences) {
@@ -216,13 +402,20 @@ void KFontChooser::Private::init(const DisplayFlags &flags, const QStringList &f
         connect(familyCheckbox, &QAbstractButton::toggled, familyListBox, &QWidget::setEnabled);
     }
 
+    prefetchTimer = new QTimer(q);
+    prefetchTimer->setSingleShot(true);
+    prefetchTimer->setInterval(0);
+    connect(prefetchTimer, &QTimer::timeout, q, [this]() {
+        _k_prefetch_styles();
+    });
+
     if (!fontList.isEmpty()) {
         setFamilyBoxItems(fontList);
     } else {
         fillFamilyListBox(flags & FixedFontsOnly);
     }
 
-    familyListBox->setMinimumWidth(minimumListWidth(familyListBox));
+    familyListBox->setMinimumWidth(familyListWidth());
     familyListBox->setMinimumHeight(minimumListHeight(familyListBox, visibleListSize));
 
 
@@ -243,21 +436,25 @@ void KFontChooser::Private::init(const DisplayFlags &flags, const QStringList &f
 
     ++row;
 
-    styleListBox = new QListWidget(page);
+    styleModel = new FontNameListModel(q);
+    styleListBox = createListView(styleModel, page);
     gridLayout->addWidget(styleListBox, row, 1);
 
     // Populate usual styles, to determine minimum list width;
     // will be replaced later with correct styles.
-    styleListBox->addItem(KFontChooser::tr("Normal", "@item font"));
-    styleListBox->addItem(KFontChooser::tr("Italic", "@item font"));
-    styleListBox->addItem(KFontChooser::tr("Oblique", "@item font"));
-    styleListBox->addItem(KFontChooser::tr("Bold", "@item font"));
-    styleListBox->addItem(KFontChooser::tr("Bold Italic", "@item font"));
+    styleModel->setNames(QStringList()
+        << KFontChooser::tr("Normal", "@item font")
+        << KFontChooser::tr("Italic", "@item font")
+        << KFontChooser::tr("Oblique", "@item font")
+        << KFontChooser::tr("Bold", "@item font")
+        << KFontChooser::tr("Bold Italic", "@item font"));
     styleListBox->setMinimumWidth(minimumListWidth(styleListBox));
     styleListBox->setMinimumHeight(minimumListHeight(styleListBox, visibleListSize));
 
-    connect(styleListBox, &QListWidget::currentTextChanged, [this](const QString &style) {
-        _k_style_chosen_slot(style);
+    connect(styleListBox->selectionModel(), &QItemSelectionModel::currentChanged, [this](const QModelIndex &current) {
+        if (current.isValid()) {
+            _k_style_chosen_slot(styleModel->text(current.row()));
+        }
     });
 
     if (flags & ShowDifferences) {
@@ -283,7 +480,8 @@ void KFontChooser::Private::init(const DisplayFlags &flags, const QStringList &f
 
     ++row;
 
-    sizeListBox = new QListWidget(page);
+    sizeModel = new FontNameListModel(q);
+    sizeListBox = createListView(sizeModel, page);
     sizeOfFont = new QDoubleSpinBox(page);
     sizeOfFont->setMinimum(4);
     sizeOfFont->setMaximum(512);
@@ -329,8 +527,10 @@ void KFontChooser::Private::init(const DisplayFlags &flags, const QStringList &f
         _k_size_value_slot(size);
     });
 
-    connect(sizeListBox, &QListWidget::currentTextChanged, [this](const QString &size) {
-        _k_size_chosen_slot(size);
+    connect(sizeListBox->selectionModel(), &QItemSelectionModel::currentChanged, [this](const QModelIndex &current) {
+        if (current.isValid()) {
+            _k_size_chosen_slot(current.row());
+        }
     });
 
     if (flags & ShowDifferences) {
@@ -519,58 +719,29 @@ QFont KFontChooser::font() const
     return d->selFont;
 }
 
-void KFontChooser::Private::_k_family_chosen_slot(const QString &family)
+void KFontChooser::Private::familyRowChosen(int familyRow)
 {
-    if (!signalsAllowed) {
+    if (!signalsAllowed || familyRow < 0) {
         return;
     }
     signalsAllowed = false;
+    // the user's choice wins over a setFont() still waiting for its family
+    selectionPending = false;
 
-    QString currentFamily;
-    if (family.isEmpty()) {
-        Q_ASSERT(familyListBox->currentItem());
-        if (familyListBox->currentItem()) {
-            currentFamily = qtFamilies[familyListBox->currentItem()->text()];
-        }
-    } else {
-        currentFamily = qtFamilies[family];
-    }
+    const QString currentFamily = familyModel->rawName(familyRow);
 
-    // Get the list of styles available in this family.
-    QFontDatabase dbase;
-    QStringList styles = dbase.styles(currentFamily);
-    if (styles.isEmpty()) {
-        // Avoid extraction, it is in kdeqt.po
-        styles.append(TR_NOX("Normal", "QFontDatabase"));
-    }
-
-    // Filter style strings and add to the listbox.
-    QString pureFamily;
-    splitFontString(family, &pureFamily);
+    // Get the validated styles available in this family and add them to the listbox.
+    const FontCatalog *catalog = FontCatalog::instance();
     QStringList filteredStyles;
-    qtStyles.clear();
+    QStringList rawStyles;
     styleIDs.clear();
-
-    const QStringList origStyles = styles;
-    for (const QString &style : origStyles) {
-        // Sometimes the font database will report an invalid style,
-        // that falls back back to another when set.
-        // Remove such styles, by checking set/get round-trip.
-        QFont testFont = dbase.font(currentFamily, style, 10);
-        if (dbase.styleString(testFont) != style) {
-            styles.removeAll(style);
-            continue;
-        }
-
-        QString fstyle = tr("%1", "@item Font style").arg(style);
-        if (!filteredStyles.contains(fstyle)) {
-            filteredStyles.append(fstyle);
-            qtStyles.insert(fstyle, style);
-            styleIDs.insert(fstyle, styleIdentifier(testFont));
-        }
+    for (const ValidatedStyle &style : validatedStyles(currentFamily)) {
+        filteredStyles.append(style.trStyle);
+        rawStyles.append(style.style);
+        styleIDs.append(style.identifier);
     }
-    styleListBox->clear();
-    styleListBox->addItems(filteredStyles);
+    prefetchNeighbourStyles();
+    styleModel->setNames(filteredStyles, rawStyles);
 
     // Try to set the current style in the listbox to that previous.
     int listPos = filteredStyles.indexOf(selectedStyle.isEmpty() ?  TR_NOX("Normal", "QFontDatabase") : selectedStyle);
@@ -592,15 +763,15 @@ void KFontChooser::Private::_k_family_chosen_slot(const QString &family)
             qSwap(styleIt, styleOb);
         }
     }
-    styleListBox->setCurrentRow(listPos >= 0 ? listPos : 0);
-    QString currentStyle = qtStyles[styleListBox->currentItem()->text()];
+    setCurrentRow(styleListBox, listPos >= 0 ? listPos : 0);
+    QString currentStyle = styleModel->rawName(currentRow(styleListBox));
 
     // Recompute the size listbox for this family/style.
     qreal currentSize = setupSizeListBox(currentFamily, currentStyle);
     sizeOfFont->setValue(currentSize);
 
-    selFont = dbase.font(currentFamily, currentStyle, int(currentSize));
-    if (dbase.isSmoothlyScalable(currentFamily, currentStyle) && selFont.pointSize() == floor(currentSize)) {
+    selFont = catalog->font(currentFamily, currentStyle, int(currentSize));
+    if (catalog->isSmoothlyScalable(currentFamily, currentStyle) && selFont.pointSize() == floor(currentSize)) {
         selFont.setPointSizeF(currentSize);
     }
     emit q->fontSelected(selFont);
@@ -613,23 +784,23 @@ void KFontChooser::Private::_k_style_chosen_slot(const QString &style)
     if (!signalsAllowed) {
         return;
     }
+    if (currentRow(familyListBox) < 0 || currentRow(styleListBox) < 0) {
+        // still waiting for the family list
+        return;
+    }
     signalsAllowed = false;
 
-    QFontDatabase dbase;
-    QString currentFamily = qtFamilies[familyListBox->currentItem()->text()];
-    QString currentStyle;
-    if (style.isEmpty()) {
-        currentStyle = qtStyles[styleListBox->currentItem()->text()];
-    } else {
-        currentStyle = qtStyles[style];
-    }
+    const FontCatalog *catalog = FontCatalog::instance();
+    QString currentFamily = familyModel->rawName(currentRow(familyListBox));
+    const int styleRow = style.isEmpty() ? currentRow(styleListBox) : styleModel->indexOf(style);
+    QString currentStyle = styleModel->rawName(styleRow >= 0 ? styleRow : currentRow(styleListBox));
 
     // Recompute the size listbox for this family/style.
     qreal currentSize = setupSizeListBox(currentFamily, currentStyle);
     sizeOfFont->setValue(currentSize);
 
-    selFont = dbase.font(currentFamily, currentStyle, int(currentSize));
-    if (dbase.isSmoothlyScalable(currentFamily, currentStyle) && selFont.pointSize() == floor(currentSize)) {
+    selFont = catalog->font(currentFamily, currentStyle, int(currentSize));
+    if (catalog->isSmoothlyScalable(currentFamily, currentStyle) && selFont.pointSize() == floor(currentSize)) {
         selFont.setPointSizeF(currentSize);
     }
     emit q->fontSelected(selFont);
@@ -641,7 +812,7 @@ void KFontChooser::Private::_k_style_chosen_slot(const QString &style)
     signalsAllowed = true;
 }
 
-void KFontChooser::Private::_k_size_chosen_slot(const QString &size)
+void KFontChooser::Private::_k_size_chosen_slot(int row)
 {
     if (!signalsAllowed) {
         return;
@@ -649,26 +820,18 @@ void KFontChooser::Private::_k_size_chosen_slot(const QString &size)
 
     signalsAllowed = false;
 
-    qreal currentSize;
-    if (size.isEmpty()) {
-        currentSize = QLocale::system().toDouble(sizeListBox->currentItem()->text());
-    } else {
-        currentSize = QLocale::system().toDouble(size);
-    }
+    const qreal currentSize = sizeValues.at(row);
 
     // Reset the customized size slot in the list if not needed.
     if (customSizeRow >= 0 && selFont.pointSizeF() != currentSize) {
-        sizeListBox->item(customSizeRow)->setText(standardSizeAtCustom);
-        customSizeRow = -1;
+        restoreCustomSizeRow();
     }
 
     sizeOfFont->setValue(currentSize);
     selFont.setPointSizeF(currentSize);
     emit q->fontSelected(selFont);
 
-    if (!size.isEmpty()) {
-        selectedSize = currentSize;
-    }
+    selectedSize = currentSize;
 
     signalsAllowed = true;
 }
@@ -678,52 +841,52 @@ void KFontChooser::Private::_k_size_value_slot(double dval)
     if (!signalsAllowed) {
         return;
     }
+    if (currentRow(familyListBox) < 0 || currentRow(styleListBox) < 0) {
+        return;
+    }
     signalsAllowed = false;
 
     // We compare with qreal, so convert for platforms where qreal != double.
     qreal val = qreal(dval);
 
-    QFontDatabase dbase;
-    QString family = qtFamilies[familyListBox->currentItem()->text()];
-    QString style = qtStyles[styleListBox->currentItem()->text()];
+    const FontCatalog *catalog = FontCatalog::instance();
+    QString family = familyModel->rawName(currentRow(familyListBox));
+    QString style = styleModel->rawName(currentRow(styleListBox));
 
     // Reset current size slot in list if it was customized.
-    if (customSizeRow >= 0 && sizeListBox->currentRow() == customSizeRow) {
-        sizeListBox->item(customSizeRow)->setText(standardSizeAtCustom);
-        customSizeRow = -1;
+    if (customSizeRow >= 0 && currentRow(sizeListBox) == customSizeRow) {
+        restoreCustomSizeRow();
     }
 
     bool canCustomize = true;
 
     // For Qt-bad-sizes workaround: skip this block unconditionally
-    if (!dbase.isSmoothlyScalable(family, style)) {
+    if (!catalog->isSmoothlyScalable(family, style)) {
         // Bitmap font, allow only discrete sizes.
         // Determine the nearest in the direction of change.
         canCustomize = false;
-        int nrows = sizeListBox->count();
-        int row = sizeListBox->currentRow();
+        int nrows = sizeValues.size();
+        int row = currentRow(sizeListBox);
         int nrow;
         if (val - selFont.pointSizeF() > 0) {
-            for (nrow = row + 1; nrow < nrows; ++nrow)
-                if (QLocale::system().toDouble(sizeListBox->item(nrow)->text()) >= val) {
-                    break;
-                }
+            // the first row after the current one with a size of at least val
+            nrow = std::lower_bound(sizeValues.constBegin(), sizeValues.constEnd(), val) - sizeValues.constBegin();
+            nrow = qMax(nrow, row + 1);
         } else {
-            for (nrow = row - 1; nrow >= 0; --nrow)
-                if (QLocale::system().toDouble(sizeListBox->item(nrow)->text()) <= val) {
-                    break;
-                }
+            // the last row before the current one with a size of at most val
+            nrow = std::upper_bound(sizeValues.constBegin(), sizeValues.constEnd(), val) - sizeValues.constBegin() - 1;
+            nrow = qMin(nrow, row - 1);
         }
         // Make sure the new row is not out of bounds.
         nrow = nrow < 0 ? 0 : nrow >= nrows ? nrows - 1 : nrow;
         // Get the size from the new row and set the spinbox to that size.
-        val = QLocale::system().toDouble(sizeListBox->item(nrow)->text());
+        val = sizeValues.value(nrow);
         sizeOfFont->setValue(val);
     }
 
     // Set the current size in the size listbox.
     int row = nearestSizeRow(val, canCustomize);
-    sizeListBox->setCurrentRow(row);
+    setCurrentRow(sizeListBox, row);
 
     selectedSize = val;
     selFont.setPointSizeF(val);
@@ -744,24 +907,42 @@ void KFontChooser::Private::_k_displaySample(const QFont &font)
 
 int KFontChooser::Private::nearestSizeRow(qreal val, bool customize)
 {
-    qreal diff = 1000;
-    int row = 0;
-    for (int r = 0; r < sizeListBox->count(); ++r) {
-        qreal cval = QLocale::system().toDouble(sizeListBox->item(r)->text());
-        if (qAbs(cval - val) < diff) {
-            diff = qAbs(cval - val);
-            row = r;
-        }
+    if (sizeValues.isEmpty()) {
+        return 0;
+    }
+    // The sizes are sorted, so the nearest one is next to where val would
+    // be inserted; on a tie the smaller size wins.
+    int row = std::lower_bound(sizeValues.constBegin(), sizeValues.constEnd(), val) - sizeValues.constBegin();
+    if (row == sizeValues.size() || (row > 0 && qAbs(sizeValues.at(row - 1) - val) <= qAbs(sizeValues.at(row) - val))) {
+        row -= 1;
     }
+    const qreal diff = qAbs(sizeValues.at(row) - val);
     // For Qt-bad-sizes workaround: ignore value of customize, use true
     if (customize && diff > 0) {
         customSizeRow = row;
-        standardSizeAtCustom = sizeListBox->item(row)->text();
-        sizeListBox->item(row)->setText(formatFontSize(val));
+        standardSizeAtCustom = sizeModel->text(row);
+        standardSizeValueAtCustom = sizeValues.at(row);
+        // as shown, i.e. rounded to one decimal
+        const QString text = formatFontSize(sizeLocale, val);
+        setSizeRowValue(row, sizeLocale.toDouble(text), text);
     }
     return row;
 }
 
+// The customized size lies between the sizes of the neighbouring rows,
+// so the values stay sorted.
+void KFontChooser::Private::setSizeRowValue(int row, qreal value, const QString &text)
+{
+    sizeValues[row] = value;
+    sizeModel->setText(row, text);
+}
+
+void KFontChooser::Private::restoreCustomSizeRow()
+{
+    setSizeRowValue(customSizeRow, standardSizeValueAtCustom, standardSizeAtCustom);
+    customSizeRow = -1;
+}
+
 qreal KFontChooser::Private::fillSizeList(const QList<qreal> &sizes_)
 {
     if (!sizeListBox) {
@@ -790,11 +971,15 @@ qreal KFontChooser::Private::fillSizeList(const QList<qreal> &sizes_)
     }
 
     // Insert sizes into the listbox.
-    sizeListBox->clear();
     std::sort(sizes.begin(), sizes.end());
+    QStringList sizeTexts;
+    sizeValues.clear();
+    sizeValues.reserve(sizes.size());
     for (qreal size : qAsConst(sizes)) {
-        sizeListBox->addItem(formatFontSize(size));
+        sizeTexts.append(formatFontSize(sizeLocale, size));
+        sizeValues.append(size);
     }
+    sizeModel->setNames(sizeTexts);
 
     // Return the nearest to selected size.
     // If the font is vector, the nearest size is always same as selected,
@@ -803,16 +988,16 @@ qreal KFontChooser::Private::fillSizeList(const QList<qreal> &sizes_)
     // thus size slot customization is not allowed.
     customSizeRow = -1;
     int row = nearestSizeRow(selectedSize, canCustomize);
-    return QLocale::system().toDouble(sizeListBox->item(row)->text());
+    return sizeValues.value(row);
 }
 
 qreal KFontChooser::Private::setupSizeListBox(const QString &family, const QString &style)
 {
-    QFontDatabase dbase;
+    const FontCatalog *catalog = FontCatalog::instance();
     QList<qreal> sizes;
-    const bool smoothlyScalable = dbase.isSmoothlyScalable(family, style);
+    const bool smoothlyScalable = catalog->isSmoothlyScalable(family, style);
     if (!smoothlyScalable) {
-        const QList<int> smoothSizes = dbase.smoothSizes(family, style);
+        const QList<int> smoothSizes = catalog->smoothSizes(family, style);
         for (int size : smoothSizes) {
             sizes.append(size);
         }
@@ -823,10 +1008,9 @@ qreal KFontChooser::Private::setupSizeListBox(const QString &family, const QStri
     qreal bestFitSize = fillSizeList(sizes);
 
     // Set the best fit size as current in the listbox if available.
-    const QList<QListWidgetItem *> selectedSizeList = sizeListBox->findItems(
-                                                        formatFontSize(bestFitSize), Qt::MatchExactly);
-    if (!selectedSizeList.isEmpty()) {
-        sizeListBox->setCurrentItem(selectedSizeList.first());
+    const int selectedSizeRow = sizeValues.indexOf(bestFitSize);
+    if (selectedSizeRow >= 0) {
+        setCurrentRow(sizeListBox, selectedSizeRow);
     }
 
     return bestFitSize;
@@ -834,8 +1018,7 @@ qreal KFontChooser::Private::setupSizeListBox(const QString &family, const QStri
 
 void KFontChooser::Private::setupDisplay()
 {
-    QFontDatabase dbase;
-    QString family = selFont.family().toLower();
+    QString family = selFont.family().toCaseFolded();
     QString styleID = styleIdentifier(selFont);
     qreal size = selFont.pointSizeF();
     if (size == -1) {
@@ -845,104 +1028,85 @@ void KFontChooser::Private::setupDisplay()
     int numEntries, i;
 
     // Direct family match.
-    numEntries = familyListBox->count();
-    for (i = 0; i < numEntries; ++i) {
-        if (family == qtFamilies[familyListBox->item(i)->text()].toLower()) {
-            familyListBox->setCurrentRow(i);
-            break;
-        }
+    int familyRow = familyModel->findFolded(family);
+
+    if (familyRow < 0 && familyRequest) {
+        // The family may still arrive, so leave the fallbacks until the
+        // list is complete; see _k_family_chunk_arrived().
+        selectionPending = true;
+        return;
     }
+    selectionPending = false;
 
     // 1st family fallback.
-    if (i == numEntries) {
+    if (familyRow < 0) {
         const int bracketPos = family.indexOf(QLatin1Char('['));
         if (bracketPos != -1) {
             family = family.leftRef(bracketPos).trimmed().toString();
-            for (i = 0; i < numEntries; ++i) {
-                if (family == qtFamilies[familyListBox->item(i)->text()].toLower()) {
-                    familyListBox->setCurrentRow(i);
-                    break;
-                }
-            }
+            familyRow = familyModel->findFolded(family);
         }
     }
 
     // 2nd family fallback.
-    if (i == numEntries) {
-        QString fallback = family + QLatin1String(" [");
-        for (i = 0; i < numEntries; ++i) {
-            if (qtFamilies[familyListBox->item(i)->text()].toLower().startsWith(fallback)) {
-                familyListBox->setCurrentRow(i);
-                break;
-            }
-        }
+    if (familyRow < 0) {
+        familyRow = familyModel->findFoldedPrefix(family + QLatin1String(" ["));
     }
 
     // 3rd family fallback.
-    if (i == numEntries) {
-        for (i = 0; i < numEntries; ++i) {
-            if (qtFamilies[familyListBox->item(i)->text()].toLower().startsWith(family)) {
-                familyListBox->setCurrentRow(i);
-                break;
-            }
-        }
+    if (familyRow < 0) {
+        familyRow = familyModel->findFoldedPrefix(family);
     }
 
     // Family fallback in case nothing matched. Otherwise, diff doesn't work
-    if (i == numEntries) {
-        familyListBox->setCurrentRow(0);
-    }
+    setCurrentRow(familyListBox, familyRow >= 0 ? familyRow : 0);
 
     // By setting the current item in the family box, the available
     // styles and sizes for that family have been collected.
     // Try now to set the current items in the style and size boxes.
 
     // Set current style in the listbox.
-    numEntries = styleListBox->count();
+    numEntries = styleModel->rowCount();
     for (i = 0; i < numEntries; ++i) {
-        if (styleID == styleIDs[styleListBox->item(i)->text()]) {
-            styleListBox->setCurrentRow(i);
+        if (styleID == styleIDs.value(i)) {
+            setCurrentRow(styleListBox, i);
             break;
         }
     }
     if (i == numEntries) {
         // Style not found, fallback.
-        styleListBox->setCurrentRow(0);
+        setCurrentRow(styleListBox, 0);
     }
 
     // Set current size in the listbox.
     // If smoothly scalable, allow customizing one of the standard size slots,
     // otherwise just select the nearest available size.
-    QString currentFamily = qtFamilies[familyListBox->currentItem()->text()];
-    QString currentStyle = qtStyles[styleListBox->currentItem()->text()];
-    bool canCustomize = dbase.isSmoothlyScalable(currentFamily, currentStyle);
-    sizeListBox->setCurrentRow(nearestSizeRow(size, canCustomize));
+    QString currentFamily = familyModel->rawName(currentRow(familyListBox));
+    QString currentStyle = styleModel->rawName(currentRow(styleListBox));
+    bool canCustomize = FontCatalog::instance()->isSmoothlyScalable(currentFamily, currentStyle);
+    setCurrentRow(sizeListBox, nearestSizeRow(size, canCustomize));
 
     // Set current size in the spinbox.
-    sizeOfFont->setValue(QLocale::system().toDouble(sizeListBox->currentItem()->text()));
+    sizeOfFont->setValue(sizeValues.value(currentRow(sizeListBox)));
 }
 
 void KFontChooser::getFontList(QStringList &list, uint fontListCriteria)
 {
-    QFontDatabase dbase;
-    QStringList lstSys(dbase.families());
+    const FontCatalog *catalog = FontCatalog::instance();
+    QStringList lstSys;
 
     // if we have criteria; then check fonts before adding
     if (fontListCriteria) {
-        QStringList lstFonts;
-        for (const QString &family : qAsConst(lstSys)) {
-            if ((fontListCriteria & FixedWidthFonts) > 0 && !dbase.isFixedPitch(family)) {
-                continue;
-            }
-            if (((fontListCriteria & (SmoothScalableFonts | ScalableFonts)) == ScalableFonts) &&
-                    !dbase.isBitmapScalable(family)) {
-                continue;
-            }
-            if ((fontListCriteria & SmoothScalableFonts) > 0 && !dbase.isSmoothlyScalable(family)) {
-                continue;
-            }
-            lstFonts.append(family);
+        uint capabilities = 0;
+        if ((fontListCriteria & FixedWidthFonts) > 0) {
+            capabilities |= FontCatalog::FixedPitch;
+        }
+        if ((fontListCriteria & (SmoothScalableFonts | ScalableFonts)) == ScalableFonts) {
+            capabilities |= FontCatalog::BitmapScalable;
+        }
+        if ((fontListCriteria & SmoothScalableFonts) > 0) {
+            capabilities |= FontCatalog::SmoothlyScalable;
         }
+        QStringList lstFonts = catalog->families(capabilities);
 
         if ((fontListCriteria & FixedWidthFonts) > 0) {
             // Fallback.. if there are no fixed fonts found, it's probably a
@@ -953,6 +1117,8 @@ void KFontChooser::getFontList(QStringList &list, uint fontListCriteria)
         }
 
         lstSys = lstFonts;
+    } else {
+        lstSys = catalog->families();
     }
 
     lstSys.sort();
@@ -964,18 +1130,184 @@ void KFontChooser::Private::setFamilyBoxItems(const QStringList &fonts)
 {
     signalsAllowed = false;
 
-    QStringList trfonts = translateFontNameList(fonts, &qtFamilies);
-    familyListBox->clear();
-    familyListBox->addItems(trfonts);
+    QHash<QString, QString> trToRawNames;
+    const QStringList trfonts = translateFontNameList(fonts, &trToRawNames);
+    QStringList rawNames;
+    rawNames.reserve(trfonts.size());
+    for (const QString &trName : trfonts) {
+        rawNames.append(trToRawNames.value(trName));
+    }
+    familyModel->setNames(trfonts, rawNames);
+    familyTextWidth = widestTextWidth(familyListBox->fontMetrics(), trfonts);
 
     signalsAllowed = true;
 }
 
+int KFontChooser::Private::familyListWidth() const
+{
+    if (familyTextWidth < 0) {
+        return minimumListWidth(familyListBox);
+    }
+    return listWidthForText(familyListBox, familyTextWidth);
+}
+
+// Querying, translating and sorting thousands of families takes long
+// enough to delay the first appearance of the chooser noticeably, so the
+// list is built on a worker thread and inserted in chunks as it arrives.
 void KFontChooser::Private::fillFamilyListBox(bool onlyFixedFonts)
 {
-    QStringList fontList;
-    getFontList(fontList, onlyFixedFonts ? FixedWidthFonts : 0);
-    setFamilyBoxItems(fontList);
+    const uint criteria = onlyFixedFonts ? FixedWidthFonts : 0;
+    if (familyRequest) {
+        familyRequest->cancelled.store(1);
+    }
+    signalsAllowed = false;
+    familyModel->clear();
+    signalsAllowed = true;
+
+    // With a known width the list gets its final size right away instead
+    // of when the last chunk has arrived.
+    const QFont listFont = familyListBox->font();
+    const QString widthKey = FamilyWidthCache::key(listFont, criteria);
+    if (!familyWidthCache()->find(FontCatalog::instance()->generation(), widthKey, &familyTextWidth)) {
+        familyTextWidth = -1;
+    }
+
+    const QSharedPointer<FamilyListRequest> request(new FamilyListRequest(this));
+    familyRequest = request;
+    QThreadPool::globalInstance()->start(new FunctionRunnable([request, criteria, listFont, widthKey]() {
+        const quint64 generation = FontCatalog::instance()->generation();
+        QStringList fontList;
+        getFontList(fontList, criteria);
+        QHash<QString, QString> trToRawNames;
+        const QStringList trFonts = translateFontNameList(fontList, &trToRawNames);
+
+        int widestText;
+        if (!familyWidthCache()->find(generation, widthKey, &widestText)) {
+            widestText = widestTextWidth(QFontMetrics(listFont), trFonts);
+            familyWidthCache()->insert(generation, widthKey, widestText);
+        }
+
+        int start = 0;
+        do {
+            if (request->cancelled.load()) {
+                return;
+            }
+            const QStringList chunk = trFonts.mid(start, FamilyChunkSize);
+            QStringList rawNames;
+            rawNames.reserve(chunk.size());
+            for (const QString &trName : chunk) {
+                rawNames.append(trToRawNames.value(trName));
+            }
+            start += FamilyChunkSize;
+            const bool last = start >= trFonts.size();
+            // the application object outlives any chooser
+            QMetaObject::invokeMethod(QCoreApplication::instance(), [request, chunk, rawNames, last, widestText]() {
+                if (request->d) {
+                    request->d->_k_family_chunk_arrived(request, chunk, rawNames, last, widestText);
+                }
+            }, Qt::QueuedConnection);
+        } while (start < trFonts.size());
+    }));
+}
+
+void KFontChooser::Private::_k_family_chunk_arrived(const QSharedPointer<FamilyListRequest> &request,
+                                                    const QStringList &families,
+                                                    const QStringList &rawFamilies, bool last, int widestText)
+{
+    if (request != familyRequest) {
+        return;
+    }
+
+    const bool wasSignalsAllowed = signalsAllowed;
+    signalsAllowed = false;
+    familyModel->append(families, rawFamilies);
+    signalsAllowed = wasSignalsAllowed;
+
+    bool resolve = false;
+    if (selectionPending) {
+        resolve = familyModel->findFolded(selFont.family().toCaseFolded()) >= 0;
+    }
+    if (last) {
+        familyRequest.reset();
+        familyTextWidth = widestText;
+        const int width = familyListWidth();
+        if (familyListBox->minimumWidth() != width) {
+            familyListBox->setMinimumWidth(width);
+        }
+        // nothing matched directly, apply the fallbacks now
+        resolve = resolve || selectionPending || currentRow(familyListBox) < 0;
+    }
+    if (resolve && wasSignalsAllowed) {
+        setupDisplay();
+    }
+}
+
+// Scrolling through the family list selects every family on the way,
+// so the (expensive) style validation is done once per family and kept
+// until the font catalog changes.
+const ValidatedStyleList &KFontChooser::Private::validatedStyles(const QString &family)
+{
+    static QHash<QString, ValidatedStyleList> cache;
+    static quint64 cacheGeneration = 0;
+
+    const FontCatalog *catalog = FontCatalog::instance();
+    if (cacheGeneration != catalog->generation()) {
+        cache.clear();
+        cacheGeneration = catalog->generation();
+    }
+
+    auto it = cache.constFind(family);
+    if (it != cache.constEnd()) {
+        return it.value();
+    }
+
+    QStringList styles = catalog->styles(family);
+    if (styles.isEmpty()) {
+        // Avoid extraction, it is in kdeqt.po
+        styles.append(TR_NOX("Normal", "QFontDatabase"));
+    }
+
+    ValidatedStyleList validated;
+    QStringList trStyles;
+    for (const QString &style : qAsConst(styles)) {
+        // Sometimes the font database will report an invalid style,
+        // that falls back back to another when set.
+        // Remove such styles, by checking set/get round-trip.
+        QFont testFont = catalog->font(family, style, 10);
+        if (catalog->styleString(testFont) != style) {
+            continue;
+        }
+
+        QString fstyle = tr("%1", "@item Font style").arg(style);
+        if (!trStyles.contains(fstyle)) {
+            trStyles.append(fstyle);
+            validated.append(ValidatedStyle{style, fstyle, styleIdentifier(testFont)});
+        }
+    }
+    return cache.insert(family, validated).value();
+}
+
+void KFontChooser::Private::prefetchNeighbourStyles()
+{
+    const int row = currentRow(familyListBox);
+    prefetchQueue.clear();
+    for (int r : {row + 1, row - 1}) {
+        if (r >= 0 && r < familyModel->rowCount()) {
+            prefetchQueue.append(familyModel->rawName(r));
+        }
+    }
+    prefetchTimer->start();
+}
+
+void KFontChooser::Private::_k_prefetch_styles()
+{
+    // one family per idle slot, to keep the GUI responsive
+    if (!prefetchQueue.isEmpty()) {
+        validatedStyles(prefetchQueue.takeFirst());
+        if (!prefetchQueue.isEmpty()) {
+            prefetchTimer->start();
+        }
+    }
 }
 
 // Human-readable style identifiers returned by QFontDatabase::styleString()
@@ -995,8 +1327,7 @@ QString KFontChooser::Private::styleIdentifier(const QFont &font)
     // "emboldening" which looks ugly.
     // See also KConfigGroupGui::writeEntryGui().
     if (styleName.isEmpty() && weight == QFont::Normal) {
-        QFontDatabase fdb;
-        const QStringList styles = fdb.styles(font.family());
+        const QStringList styles = FontCatalog::instance()->styles(font.family());
         for (const QString &style : styles) {
             // orderded by commonness, i.e. "Regular" is the most common
             if (style == QLatin1String("Regular")
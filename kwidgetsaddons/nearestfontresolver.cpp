@@ -0,0 +1,123 @@
+/*
+    SPDX-FileCopyrightText: 2003 Nadeem Hasan <nhasan@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "nearestfontresolver_p.h"
+#include "fontcatalog_p.h"
+
+#include <QFontInfo>
+#include <QMutexLocker>
+
+#include <cmath>
+
+// Determine if the font with given properties is available on the system,
+// otherwise find and return the best fitting combination. The family is
+// the one of the font when it exists, the font itself is not consulted
+// again in that case.
+static QFont nearestExistingFont(const QFont &font, QString family, QString style, bool *familyFound)
+{
+    const FontCatalog *catalog = FontCatalog::instance();
+
+    qreal size = font.pointSizeF();
+
+    // Check if the family exists.
+    *familyFound = catalog->hasFamily(family);
+    if (!*familyFound) {
+        // Chose another family.
+        family = QFontInfo(font).family(); // the nearest match
+        if (!catalog->hasFamily(family)) {
+            const QStringList families = catalog->families();
+            family = families.count() ? families.at(0) : QStringLiteral("fixed");
+        }
+    }
+
+    // Check if the family has the requested style.
+    // Easiest by piping it through font selection in the database.
+    QString retStyle = catalog->styleString(catalog->font(family, style, 10));
+    style = retStyle;
+
+    // Check if the family has the requested size.
+    // Only for bitmap fonts.
+    if (!catalog->isSmoothlyScalable(family, style)) {
+        const QList<int> sizes = catalog->smoothSizes(family, style);
+        if (!sizes.contains(size)) {
+            // Find nearest available size.
+            int mindiff = 1000;
+            int refsize = size;
+            for (int lsize : sizes) {
+                int diff = qAbs(refsize - lsize);
+                if (mindiff > diff) {
+                    mindiff = diff;
+                    size = lsize;
+                }
+            }
+        }
+    }
+
+    // Select the font with confirmed properties.
+    QFont result = catalog->font(family, style, int(size));
+    if (catalog->isSmoothlyScalable(family, style) && result.pointSize() == floor(size)) {
+        result.setPointSizeF(size);
+    }
+    return result;
+}
+
+uint qHash(const NearestFontResolver::Key &key, uint seed)
+{
+    return qHash(key.family, seed) ^ qHash(key.style) ^ qHash(key.size);
+}
+
+NearestFontResolver *NearestFontResolver::instance()
+{
+    // C++11 guarantees thread-safe initialisation of the static local.
+    static NearestFontResolver *resolver = new NearestFontResolver;
+    return resolver;
+}
+
+NearestFontResolver::NearestFontResolver()
+    : m_results(256)
+{
+}
+
+QFont NearestFontResolver::resolve(const QFont &font)
+{
+    const FontCatalog *catalog = FontCatalog::instance();
+    const Key key{font.family(), catalog->styleString(font), font.pointSizeF()};
+    const quint64 generation = catalog->generation();
+
+    {
+        QMutexLocker locker(&m_lock);
+        if (m_generation != generation) {
+            m_results.clear();
+            m_generation = generation;
+        }
+        if (const QFont *result = m_results.object(key)) {
+            m_hits.fetchAndAddRelaxed(1);
+            return *result;
+        }
+    }
+    m_misses.fetchAndAddRelaxed(1);
+
+    // Resolved without holding the lock, the catalog has its own.
+    bool familyFound;
+    const QFont result = nearestExistingFont(font, key.family, key.style, &familyFound);
+    if (familyFound) {
+        QMutexLocker locker(&m_lock);
+        if (m_generation == generation) {
+            m_results.insert(key, new QFont(result));
+        }
+    }
+    return result;
+}
+
+quint64 NearestFontResolver::hits() const
+{
+    return m_hits.load();
+}
+
+quint64 NearestFontResolver::misses() const
+{
+    return m_misses.load();
+}
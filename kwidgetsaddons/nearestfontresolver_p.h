@@ -0,0 +1,62 @@
+/*
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+#ifndef NEARESTFONTRESOLVER_P_H
+#define NEARESTFONTRESOLVER_P_H
+
+// Maps requested fonts to fonts that exist on the system, for KFontRequester.
+
+#include <QAtomicInteger>
+#include <QCache>
+#include <QFont>
+#include <QMutex>
+#include <QString>
+
+/**
+  * @internal
+  *
+  * Determines if a font with the family, style and size of a given font is
+  * available on the system, and otherwise finds the best fitting one.
+  * Results are kept per (family, style string, size) until the font
+  * catalog changes; fonts whose family does not exist are resolved through
+  * QFontInfo, which looks at all of their properties, and are not cached.
+  *
+  * All methods can be called from any thread.
+  */
+class NearestFontResolver
+{
+public:
+    static NearestFontResolver *instance();
+
+    QFont resolve(const QFont &font);
+
+    /**
+     * @return the number of resolve() calls answered from the cache,
+     * and of those that were not
+     */
+    quint64 hits() const;
+    quint64 misses() const;
+
+private:
+    NearestFontResolver();
+
+    struct Key {
+        QString family;
+        QString style;
+        qreal size;
+
+        bool operator==(const Key &other) const
+        {
+            return size == other.size && family == other.family && style == other.style;
+        }
+    };
+    friend uint qHash(const Key &key, uint seed);
+
+    QMutex m_lock;
+    QCache<Key, QFont> m_results;
+    quint64 m_generation = 0;
+    QAtomicInteger<quint64> m_hits;
+    QAtomicInteger<quint64> m_misses;
+};
+
+#endif
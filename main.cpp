@@ -50,7 +50,18 @@
 #include <QSet>
 #include <QDebug>
 
+#include <algorithm>
+
 #include "dialog.h"
+#include "batchcheck.h"
+#include "fontscan.h"
+#include "diagnostics.h"
+#include "benchmark.h"
+#include "fontstyleclassifier.h"
+#include "fontweightmapper.h"
+#include "kwidgetsaddons/fontcatalog_p.h"
+#include "kwidgetsaddons/fonthelpers_p.h"
+#include "kwidgetsaddons/nearestfontresolver_p.h"
 
 class QFontStyleSet : public QSet<QString>
 {
@@ -137,19 +148,242 @@ void doSomethingWithQFont(QFont &fnt)
 #include "timing.c"
 
 bool doBenchmark = false;
+bool doSyncFontDetails = false;
+
+// Does every pattern from the list, and compareTo, match the list?
+// These cases used to be timed inline in main() with a fixed N.
+static void registerStyleBenchmarks(const QFontStyleSet &styles, const QString &compareTo)
+{
+    const QStringList styleList = styles.list();
+    const FontStyleClassifier &classifier = FontStyleClassifier::forCurrentLocale();
+    for (bool exact : {true, false}) {
+        const QString suffix = exact ? QStringLiteral("/exact") : QStringLiteral("/contains");
+        Benchmark::registerBenchmark(QStringLiteral("styles/qstringCompareToList") + suffix,
+            [=](quint64 iterations) {
+                for (quint64 i = 0 ; i < iterations ; ++i) {
+                    const QString &pattern = styleList.at(i % styleList.size());
+                    Benchmark::doNotOptimize(qstringCompareToList(pattern, styleList, exact)
+                        && qstringCompareToList(compareTo, styleList, exact));
+                }
+            });
+        Benchmark::registerBenchmark(QStringLiteral("styles/QFontStyleSet::contains") + suffix,
+            [=](quint64 iterations) {
+                for (quint64 i = 0 ; i < iterations ; ++i) {
+                    const QString &pattern = styleList.at(i % styleList.size());
+                    Benchmark::doNotOptimize(styles.contains(pattern, exact) && styles.contains(compareTo, exact));
+                }
+            });
+        Benchmark::registerBenchmark(QStringLiteral("styles/FontStyleClassifier::classes") + suffix,
+            [=, &classifier](quint64 iterations) {
+                for (quint64 i = 0 ; i < iterations ; ++i) {
+                    const QString &pattern = styleList.at(i % styleList.size());
+                    Benchmark::doNotOptimize(bool((classifier.classes(pattern, exact) & FontStyleClassifier::BlackClass)
+                        && (classifier.classes(compareTo, exact) & FontStyleClassifier::BlackClass)));
+                }
+            });
+    }
+}
+
+// Map the style names of all installed faces, plus some that exercise the
+// translated and the fallback tests, with getFontWeight() and FontWeightMapper.
+static void registerWeightBenchmarks()
+{
+    QStringList styleNames = QStringList()
+        << QStringLiteral("Regular") << QStringLiteral("Bold Italic") << QStringLiteral("SemiBold")
+        << QStringLiteral("ExtraLight") << QStringLiteral("Ultra Bold") << QStringLiteral("Heavy Oblique")
+        << QStringLiteral("Condensed") << QStringLiteral("W3") << QStringLiteral("Roman");
+    const FontCatalog *catalog = FontCatalog::instance();
+    QSet<QString> seen;
+    for (const QString &family : catalog->families()) {
+        for (const QString &style : catalog->styles(family)) {
+            if (!seen.contains(style)) {
+                seen.insert(style);
+                styleNames << style;
+            }
+        }
+    }
+
+    const FontWeightMapper &mapper = FontWeightMapper::forCurrentLocale();
+    int mismatches = 0;
+    for (const QString &style : qAsConst(styleNames)) {
+        const int expected = FontWeightMapper::reference(style);
+        if (mapper.weight(style) != expected) {
+            qWarning() << "FontWeightMapper maps" << style << "to" << mapper.weight(style)
+                << "instead of" << expected;
+            mismatches += 1;
+        }
+    }
+    qInfo() << "FontWeightMapper agrees with getFontWeight() for" << styleNames.size() - mismatches
+        << "of" << styleNames.size() << "style names";
+
+    Benchmark::registerBenchmark(QStringLiteral("weights/getFontWeight"),
+        [=](quint64 iterations) {
+            for (quint64 i = 0 ; i < iterations ; ++i) {
+                Benchmark::doNotOptimize(FontWeightMapper::reference(styleNames.at(i % styleNames.size())));
+            }
+        });
+    Benchmark::registerBenchmark(QStringLiteral("weights/FontWeightMapper"),
+        [=, &mapper](quint64 iterations) {
+            for (quint64 i = 0 ; i < iterations ; ++i) {
+                Benchmark::doNotOptimize(mapper.weight(styleNames.at(i % styleNames.size())));
+            }
+        });
+}
+
+// translateFontNameList() as it was before it sorted with collation keys:
+// a localeAwareCompare() per comparison and no translation cache.
+static QStringList referenceTranslateFontNameList(const QStringList &names)
+{
+    const QStringList genericNames {
+        QStringLiteral("Monospace"),
+        QStringLiteral("Serif"),
+        QStringLiteral("Sans Serif"),
+    };
+    QStringList trNames;
+    QSet<QString> trSet;
+    for (const QString &name : names) {
+        const QString trName = translateFontName(name);
+        if (!genericNames.contains(name)) {
+            trNames.append(trName);
+        }
+        trSet.insert(trName);
+    }
+    std::sort(trNames.begin(), trNames.end(), [](const QString &a, const QString &b) {
+        return QString::localeAwareCompare(a, b) < 0;
+    });
+    for (const QString &genericName : genericNames) {
+        const QString trGenericName = translateFontName(genericName);
+        if (trSet.contains(trGenericName)) {
+            trNames.prepend(trGenericName);
+        }
+    }
+    return trNames;
+}
+
+// Sort a synthetic list of 50000 family names, some with foundries and
+// some outside ASCII, the old way and with translateFontNameList().
+static void registerFontNameBenchmarks()
+{
+    const QStringList words = QStringList()
+        << QStringLiteral("Noto") << QStringLiteral("Sans") << QStringLiteral("serif") << QStringLiteral("DejaVu")
+        << QStringLiteral("\u00C5ngstr\u00F6m") << QStringLiteral("\u00C9criture") << QStringLiteral("Mono") << QStringLiteral("\u0152uvre")
+        << QStringLiteral("\u00E7a") << QStringLiteral("Zapf") << QStringLiteral("Ubuntu") << QStringLiteral("Source")
+        << QStringLiteral("Code") << QStringLiteral("Pro") << QStringLiteral("Liberation") << QStringLiteral("\u00C4rger");
+    QStringList names = QStringList()
+        << QStringLiteral("Sans Serif") << QStringLiteral("Serif") << QStringLiteral("Monospace");
+    for (int i = 0 ; names.size() < 50000 ; ++i) {
+        QString name = QStringLiteral("%1 %2 %3").arg(words.at(i % words.size()),
+            words.at((i / words.size()) % words.size()), QString::number(i, 36));
+        if (i % 7 == 0) {
+            name += QStringLiteral(" [%1]").arg(words.at((i / 7) % words.size()));
+        }
+        names << name;
+    }
+
+    const QStringList expected = referenceTranslateFontNameList(names);
+    const QStringList sorted = translateFontNameList(names);
+    int mismatches = 0;
+    for (int i = 0 ; i < qMax(expected.size(), sorted.size()) ; ++i) {
+        // the order of names that collate equally was never defined
+        if (i >= expected.size() || i >= sorted.size()
+                || (expected.at(i) != sorted.at(i) && QString::localeAwareCompare(expected.at(i), sorted.at(i)) != 0)) {
+            if (mismatches == 0) {
+                qWarning() << "translateFontNameList() differs from localeAwareCompare() order at" << i;
+            }
+            mismatches += 1;
+        }
+    }
+    qInfo() << "translateFontNameList() sorts" << sorted.size() - mismatches << "of" << sorted.size()
+        << "names like localeAwareCompare()";
+
+    Benchmark::registerBenchmark(QStringLiteral("fontnames/localeAwareCompare"),
+        [=](quint64 iterations) {
+            for (quint64 i = 0 ; i < iterations ; ++i) {
+                Benchmark::doNotOptimize(referenceTranslateFontNameList(names));
+            }
+        });
+    Benchmark::registerBenchmark(QStringLiteral("fontnames/translateFontNameList"),
+        [=](quint64 iterations) {
+            for (quint64 i = 0 ; i < iterations ; ++i) {
+                Benchmark::doNotOptimize(translateFontNameList(names));
+            }
+        });
+}
 
 int main(int argc, char *argv[])
 {
+    if ((batchModeRequested(argc, argv) || fontScanRequested(argc, argv))
+            && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        // the batch and scan modes never show a window
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
     QApplication app(argc, argv);
+    // to match the default Info.plist that qmake creates; set before anything
+    // looks up QStandardPaths, such as the font catalog's disk cache
+    app.setOrganizationName("yourcompany");
     QSettings::setDefaultFormat(QSettings::IniFormat);
 
     QCommandLineParser parser;
     parser.addHelpOption();
     QCommandLineOption benchmark(QStringLiteral("benchmark"), QStringLiteral("measure timings for certain operations"));
     parser.addOption(benchmark);
+    QCommandLineOption logAdvances(QStringLiteral("log-advances"),
+        QStringLiteral("log the glyph advances and bounding rects of the text rendered with QRawFont (same as adding \"advances\" to --diag)"));
+    parser.addOption(logAdvances);
+    QCommandLineOption diag(QStringLiteral("diag"),
+        QStringLiteral("comma-separated diagnostics categories to log: details, selection, advances, timing, all or none (default: details,selection,timing)"),
+        QStringLiteral("categories"), QStringLiteral("details,selection,timing"));
+    parser.addOption(diag);
+    QCommandLineOption diagFormat(QStringLiteral("diag-format"),
+        QStringLiteral("diagnostics format: text (default) or json"), QStringLiteral("format"));
+    parser.addOption(diagFormat);
+    QCommandLineOption diagOutput(QStringLiteral("diag-output"),
+        QStringLiteral("append the diagnostics to <file> instead of writing them to stdout"), QStringLiteral("file"));
+    parser.addOption(diagOutput);
+    QCommandLineOption syncFontDetails(QStringLiteral("sync-font-details"),
+        QStringLiteral("compute the font reports on the GUI thread, as before, to compare the --benchmark selection times"));
+    parser.addOption(syncFontDetails);
+    QCommandLineOption batch(QStringLiteral("batch"),
+        QStringLiteral("check the settings round trips of all installed faces without GUI and write a JSON-lines report to <file> (- for stdout)"),
+        QStringLiteral("file"));
+    parser.addOption(batch);
+    QCommandLineOption jobs(QStringLiteral("jobs"),
+        QStringLiteral("number of worker threads for --batch and --scan-fonts (default: all cores)"), QStringLiteral("N"));
+    parser.addOption(jobs);
+    QCommandLineOption scanFonts(QStringLiteral("scan-fonts"),
+        QStringLiteral("load every font file below <dir> with QRawFont without GUI and write a JSON-lines report"),
+        QStringLiteral("dir"));
+    parser.addOption(scanFonts);
+    QCommandLineOption scanReport(QStringLiteral("scan-report"),
+        QStringLiteral("write the --scan-fonts report to <file> instead of stdout"), QStringLiteral("file"));
+    parser.addOption(scanReport);
+    QCommandLineOption benchmarkFilter(QStringLiteral("benchmark-filter"),
+        QStringLiteral("only run the benchmarks whose name matches <regexp>"), QStringLiteral("regexp"));
+    parser.addOption(benchmarkFilter);
+    QCommandLineOption benchmarkFormat(QStringLiteral("benchmark-format"),
+        QStringLiteral("benchmark report format: text (default), csv or json"), QStringLiteral("format"));
+    parser.addOption(benchmarkFormat);
+    QCommandLineOption benchmarkOutput(QStringLiteral("benchmark-output"),
+        QStringLiteral("append the benchmark reports to <file> instead of writing them to stdout"), QStringLiteral("file"));
+    parser.addOption(benchmarkOutput);
+    QCommandLineOption benchmarkSamples(QStringLiteral("benchmark-samples"),
+        QStringLiteral("number of timed samples per benchmark (default: 15)"), QStringLiteral("N"));
+    parser.addOption(benchmarkSamples);
     parser.process(app);
 
     doBenchmark = parser.isSet(benchmark);
+    doSyncFontDetails = parser.isSet(syncFontDetails);
+    Benchmark::Settings &benchmarkSettings = Benchmark::settings();
+    benchmarkSettings.filter = parser.value(benchmarkFilter);
+    benchmarkSettings.output = parser.value(benchmarkOutput);
+    if (parser.value(benchmarkFormat) == QLatin1String("csv")) {
+        benchmarkSettings.format = Benchmark::CsvFormat;
+    } else if (parser.value(benchmarkFormat) == QLatin1String("json")) {
+        benchmarkSettings.format = Benchmark::JsonFormat;
+    }
+    if (parser.value(benchmarkSamples).toInt() > 0) {
+        benchmarkSettings.samples = parser.value(benchmarkSamples).toInt();
+    }
 
 #ifndef QT_NO_TRANSLATION
     QString translatorFileName = QLatin1String("qt_");
@@ -158,6 +392,13 @@ int main(int argc, char *argv[])
     if (translator->load(translatorFileName, QLibraryInfo::location(QLibraryInfo::TranslationsPath)))
         app.installTranslator(translator);
 #endif
+    if (parser.isSet(batch)) {
+        return runBatchCheck(parser.value(batch), parser.value(jobs).toInt());
+    }
+    if (parser.isSet(scanFonts)) {
+        return runFontScan(parser.value(scanFonts), parser.value(scanReport), parser.value(jobs).toInt());
+    }
+
     QFontStyleSet demiBoldStyles;
     demiBoldStyles << QCoreApplication::translate("QFontDatabase", "DemiBold").toLower()
                 << QCoreApplication::translate("QFontDatabase", "Demi Bold").toLower()
@@ -168,46 +409,38 @@ int main(int argc, char *argv[])
                 << QCoreApplication::translate("QFontDatabase", "Ultra").toLower()
                 << QCoreApplication::translate("QFontDatabase", "Heavy").toLower()
                 << QCoreApplication::translate("QFontDatabase", "UltraBold").toLower();
-    QStringList blackStyleList = blackStyles.list();
-    QString pattern = "black", compareTo = "heavy";
-//     qDebug() << "pattern=" << pattern << "matches compareTo=" << compareTo
-//         << " in list" << blackStyles << "(" << blackStyleList << "):";
-//     qDebug() << "qstringCompareToList:" << qstringCompareToList(pattern, blackStyles.list(), true) << " vs "
-//         << qstringCompareToList(compareTo, blackStyles.list(), true);
-//     qDebug() << "QFontStyleSet:" << blackStyles.contains(pattern, false) << " vs "
-//         << blackStyles.contains(compareTo, true);
+    QString compareTo = "heavy";
 
     if (doBenchmark) {
-        const int N = 1000000;
-        init_HRTime();
-        bool found = true, exact = true;
-        HRTime_tic();
-        for( int i = 0 ; i < N && found; ++i ){
-            pattern = blackStyleList[i % blackStyleList.size()];
-        }
-        double overhead = HRTime_toc();
-        for( int j = 0 ; j < 2 ; ++j ){
-            HRTime_tic();
-            for( int i = 0 ; i < N && found; ++i ){
-                pattern = blackStyleList[i % blackStyleList.size()];
-                found =  qstringCompareToList(pattern, blackStyleList, exact) && qstringCompareToList(compareTo, blackStyleList, exact);
-            }
-            qInfo() << N << " times qstringCompareToList in " << HRTime_toc() - overhead << " seconds; exact=" << exact;
-            HRTime_tic();
-            for( int i = 0 ; i < N && found; ++i ){
-                pattern = blackStyleList[i % blackStyleList.size()];
-                found = blackStyles.contains(pattern, exact) && blackStyles.contains(compareTo, exact);
-            }
-            qInfo() << N << " times QFontStyleSet::contains in " << HRTime_toc() - overhead << " seconds; exact=" << exact;
+        registerStyleBenchmarks(blackStyles, compareTo);
+        registerWeightBenchmarks();
+        registerFontNameBenchmarks();
+        Benchmark::report(Benchmark::run(QStringLiteral("^(styles|weights|fontnames)/")));
+    }
 
-            exact = false;
-        }
+    bool validCategories;
+    quint32 diagCategories = Diagnostics::parseCategories(parser.value(diag), &validCategories);
+    if (!validCategories) {
+        qWarning() << "Unknown diagnostics category in" << parser.value(diag);
+    }
+    if (parser.isSet(logAdvances)) {
+        diagCategories |= Diagnostics::Advances;
+    }
+    if (diagCategories
+            && !Diagnostics::start(diagCategories,
+                                   parser.value(diagFormat) == QLatin1String("json") ? Diagnostics::JsonFormat : Diagnostics::TextFormat,
+                                   parser.value(diagOutput))) {
+        qWarning() << "Cannot write diagnostics to" << parser.value(diagOutput);
     }
 
-    // to match the default Info.plist that qmake creates:
-    app.setOrganizationName("yourcompany");
     Dialog dialog;
     dialog.show();
 
-    return app.exec();
+    const int ret = app.exec();
+    Diagnostics::stop();
+    if (doBenchmark) {
+        const NearestFontResolver *resolver = NearestFontResolver::instance();
+        qInfo() << "nearest existing font lookups:" << resolver->hits() << "cached," << resolver->misses() << "resolved";
+    }
+    return ret;
 }
@@ -0,0 +1,82 @@
+/*!
+ *  @file mappedfontfile.cpp
+ *
+ *  Read-only memory mappings of font files that can be handed to QRawFont
+ *  and QFontDatabase::addApplicationFontFromData() without copying.
+ *
+ */
+
+#include "mappedfontfile.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QDebug>
+
+#include <climits>
+
+namespace {
+
+struct Mapping {
+    QFile *file;    // kept open for the lifetime of the mapping, i.e. forever; null when not mapped
+    QByteArray data;
+    bool mapped;
+    // the file the data came from; a file that changes is mapped again
+    qint64 size;
+    QDateTime lastModified;
+};
+
+} // namespace
+
+QByteArray MappedFontFile::data(const QString &fileName, bool *mapped)
+{
+    static QMutex lock;
+    static QHash<QString, Mapping> mappings;
+
+    const QFileInfo info(fileName);
+    const QString key = info.canonicalFilePath().isEmpty() ? info.absoluteFilePath() : info.canonicalFilePath();
+
+    QMutexLocker locker(&lock);
+    auto it = mappings.constFind(key);
+    if (it != mappings.constEnd() && (it->size != info.size() || it->lastModified != info.lastModified())) {
+        // The fonts loaded from the old data keep referring to it, so the
+        // old mapping stays; it is only no longer handed out.
+        mappings.remove(key);
+        it = mappings.constEnd();
+    }
+    if (it == mappings.constEnd()) {
+        QFile *file = new QFile(key);
+        if (!file->open(QIODevice::ReadOnly)) {
+            qWarning() << "Cannot open" << fileName << ":" << file->errorString();
+            delete file;
+            if (mapped) {
+                *mapped = false;
+            }
+            return QByteArray();
+        }
+        Mapping mapping;
+        mapping.file = file;
+        mapping.size = info.size();
+        mapping.lastModified = info.lastModified();
+        const qint64 size = file->size();
+        // QByteArray sizes are ints
+        uchar *address = (size > 0 && size <= INT_MAX) ? file->map(0, size) : nullptr;
+        if (address) {
+            mapping.data = QByteArray::fromRawData(reinterpret_cast<const char *>(address), int(size));
+            mapping.mapped = true;
+        } else {
+            mapping.data = file->readAll();
+            mapping.mapped = false;
+            mapping.file = nullptr;
+            delete file;
+        }
+        it = mappings.insert(key, mapping);
+    }
+    if (mapped) {
+        *mapped = it->mapped;
+    }
+    return it->data;
+}
@@ -0,0 +1,34 @@
+/*!
+ *  @file mappedfontfile.h
+ *
+ *  Read-only memory mappings of font files that can be handed to QRawFont
+ *  and QFontDatabase::addApplicationFontFromData() without copying.
+ *
+ */
+
+#ifndef MAPPEDFONTFILE_H
+#define MAPPEDFONTFILE_H
+
+#include <QByteArray>
+#include <QString>
+
+class MappedFontFile
+{
+public:
+    /**
+     * @return the contents of @p fileName as a QByteArray that refers to a
+     * read-only mapping of the file (QByteArray::fromRawData()), or a null
+     * QByteArray if the file cannot be opened. Falls back to reading the
+     * file into memory when it cannot be mapped; @p mapped tells which.
+     *
+     * QRawFont and the application font database keep referring to the
+     * data, so mappings are never released: each file is mapped once and
+     * later requests return the same buffer, as long as the file's size and
+     * modification time stay the same. A file that changed is mapped again;
+     * fonts still using the old mapping of a file that shrank in place will
+     * crash the application when they read past its new end.
+     */
+    static QByteArray data(const QString &fileName, bool *mapped = nullptr);
+};
+
+#endif // MAPPEDFONTFILE_H
@@ -0,0 +1,98 @@
+/*!
+ *  @file settingswriter.cpp
+ *
+ *  Coalesces QSettings writes that follow each other closely and performs
+ *  them on a worker thread.
+ *
+ */
+
+#include "settingswriter.h"
+
+#include <QCoreApplication>
+#include <QRunnable>
+#include <QSettings>
+#include <QDebug>
+
+namespace {
+
+class SettingsWriteJob : public QRunnable
+{
+public:
+    SettingsWriteJob(const QMap<QString, QVariant> &values, const QMap<QString, SettingsWriter::Converter> &converters)
+        : values(values)
+        , converters(converters)
+    {}
+
+    void run() override
+    {
+        QSettings store;
+        for (auto it = values.constBegin(); it != values.constEnd(); ++it) {
+            const SettingsWriter::Converter convert = converters.value(it.key());
+            store.setValue(it.key(), convert ? convert(it.value()) : it.value());
+        }
+        store.sync();
+        if (store.status() != QSettings::NoError) {
+            qWarning() << "Cannot write the settings to" << store.fileName() << "status:" << store.status();
+        }
+    }
+
+private:
+    const QMap<QString, QVariant> values;
+    const QMap<QString, SettingsWriter::Converter> converters;
+};
+
+} // namespace
+
+SettingsWriter::SettingsWriter(int delay, QObject *parent)
+    : QObject(parent)
+{
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(delay);
+    connect(&m_timer, &QTimer::timeout, this, &SettingsWriter::writePending);
+    m_pool.setMaxThreadCount(1);
+    if (QCoreApplication *app = QCoreApplication::instance()) {
+        connect(app, &QCoreApplication::aboutToQuit, this, &SettingsWriter::flush);
+    }
+}
+
+SettingsWriter::~SettingsWriter()
+{
+    flush();
+}
+
+void SettingsWriter::setValue(const QString &key, const QVariant &value)
+{
+    m_converters.remove(key);
+    m_pending.insert(key, value);
+    m_requests += 1;
+    // The window starts with the first pending value, so that a steady
+    // stream of changes is still written every so often.
+    if (!m_timer.isActive()) {
+        m_timer.start();
+    }
+}
+
+void SettingsWriter::setValue(const QString &key, const QVariant &value, const Converter &convert)
+{
+    setValue(key, value);
+    m_converters.insert(key, convert);
+}
+
+void SettingsWriter::flush()
+{
+    m_timer.stop();
+    writePending();
+    m_pool.waitForDone();
+}
+
+void SettingsWriter::writePending()
+{
+    if (m_pending.isEmpty()) {
+        return;
+    }
+    m_valuesWritten += quint64(m_pending.size());
+    m_writes += 1;
+    m_pool.start(new SettingsWriteJob(m_pending, m_converters));
+    m_pending.clear();
+    m_converters.clear();
+}
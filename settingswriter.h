@@ -0,0 +1,86 @@
+/*!
+ *  @file settingswriter.h
+ *
+ *  Coalesces QSettings writes that follow each other closely and performs
+ *  them on a worker thread.
+ *
+ */
+
+#ifndef SETTINGSWRITER_H
+#define SETTINGSWRITER_H
+
+#include <QObject>
+#include <QMap>
+#include <QString>
+#include <QThreadPool>
+#include <QTimer>
+#include <QVariant>
+
+#include <functional>
+
+class SettingsWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Values set within @p delay milliseconds of the first pending one are
+     * written together, each key once with its latest value.
+     */
+    explicit SettingsWriter(int delay = 250, QObject *parent = nullptr);
+    ~SettingsWriter();
+
+    typedef std::function<QVariant(const QVariant &)> Converter;
+
+    /**
+     * Stores @p value under @p key in the default QSettings, asynchronously.
+     * Must be called from the thread the writer lives in.
+     */
+    void setValue(const QString &key, const QVariant &value);
+
+    /**
+     * Stores what @p convert makes of @p value. The conversion runs on the
+     * worker thread, and only for the value that is actually written.
+     */
+    void setValue(const QString &key, const QVariant &value, const Converter &convert);
+
+    /**
+     * Writes the pending values and waits until all writes are done.
+     * Called automatically when the application is about to quit.
+     */
+    void flush();
+
+    quint64 requests() const
+    {
+        return m_requests;
+    }
+    /**
+     * @return the number of QSettings write-and-sync rounds
+     */
+    quint64 writes() const
+    {
+        return m_writes;
+    }
+    /**
+     * @return the number of values that were replaced by a later one
+     * before they were written
+     */
+    quint64 coalesced() const
+    {
+        return m_requests - m_valuesWritten - quint64(m_pending.size());
+    }
+
+private:
+    void writePending();
+
+    QTimer m_timer;
+    QMap<QString, QVariant> m_pending;
+    QMap<QString, Converter> m_converters;  // for some of the pending keys
+    // a single thread, so that the writes happen in order
+    QThreadPool m_pool;
+    quint64 m_requests = 0;
+    quint64 m_valuesWritten = 0;
+    quint64 m_writes = 0;
+};
+
+#endif // SETTINGSWRITER_H
@@ -0,0 +1,301 @@
+/*!
+ *  @file storedfont.cpp
+ *
+ *  A compact, versioned binary description of a font for the settings,
+ *  which records the exact face: family, PostScript name and style name,
+ *  the weight on the OpenType scale, stretch, slant and size, and a hash of
+ *  the face's identifying tables.
+ *
+ */
+
+#include "storedfont.h"
+#include "kwidgetsaddons/fontcatalog_p.h"
+
+#include <QRawFont>
+#include <QtEndian>
+
+#include <cstring>
+
+namespace {
+
+const char Magic[4] = { 'F', 'W', 'F', 'D' };
+
+// the QFont::Weight values and their OpenType counterparts, with 99 for 1000
+const int QtWeights[] = { 0, 12, 25, 50, 57, 63, 75, 81, 87, 99 };
+const int OpenTypeWeights[] = { 100, 200, 300, 400, 500, 600, 700, 800, 900, 1000 };
+const int WeightAnchors = int(sizeof(QtWeights) / sizeof(QtWeights[0]));
+
+int interpolate(int value, const int *from, const int *to)
+{
+    if (value <= from[0]) {
+        return to[0];
+    }
+    for (int i = 1; i < WeightAnchors; ++i) {
+        if (value <= from[i]) {
+            return to[i - 1] + qRound(double(value - from[i - 1]) * (to[i] - to[i - 1]) / (from[i] - from[i - 1]));
+        }
+    }
+    return to[WeightAnchors - 1];
+}
+
+inline quint16 nameTableValue(const uchar *p)
+{
+    return qFromBigEndian<quint16>(p);
+}
+
+// FNV-1a, so that the hash is the same in every run and on every platform
+quint64 fnv1a(const QByteArray &data, quint64 hash)
+{
+    for (const char c : data) {
+        hash ^= uchar(c);
+        hash *= Q_UINT64_C(0x100000001b3);
+    }
+    return hash;
+}
+
+} // namespace
+
+// the stored header is little-endian; converting is its own inverse
+void StoredFont::convertHeader(Header &h)
+{
+    h.version = qFromLittleEndian(h.version);
+    h.headerSize = qFromLittleEndian(h.headerSize);
+    h.contentHash = qFromLittleEndian(h.contentHash);
+    h.size = qFromLittleEndian(h.size);
+    h.weight = qFromLittleEndian(h.weight);
+    h.stretch = qFromLittleEndian(h.stretch);
+    h.slant = qFromLittleEndian(h.slant);
+    h.styleHint = qFromLittleEndian(h.styleHint);
+    h.flags = qFromLittleEndian(h.flags);
+    h.familyLength = qFromLittleEndian(h.familyLength);
+    h.postScriptNameLength = qFromLittleEndian(h.postScriptNameLength);
+    h.styleNameLength = qFromLittleEndian(h.styleNameLength);
+}
+
+StoredFont::StoredFont()
+{
+    std::memset(&m_header, 0, sizeof(m_header));
+}
+
+StoredFont StoredFont::fromFont(const QFont &font)
+{
+    const QRawFont raw = QRawFont::fromFont(font);
+    const QString family = font.family().left(0xffff);
+    const QString postScript = raw.isValid() ? postScriptName(raw).left(0xffff) : QString();
+    const QString style = font.styleName().left(0xffff);
+
+    Header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, Magic, sizeof(Magic));
+    h.version = Version;
+    h.headerSize = sizeof(Header);
+    h.contentHash = raw.isValid() ? contentHash(raw) : 0;
+    const bool pixelSized = font.pointSizeF() <= 0;
+    const double size = pixelSized ? double(font.pixelSize()) : double(font.pointSizeF());
+    std::memcpy(&h.size, &size, sizeof(size));
+    h.weight = quint16(toOpenTypeWeight(font.weight()));
+    h.stretch = quint16(font.stretch());
+    h.slant = quint16(font.style());
+    h.styleHint = quint16(font.styleHint());
+    h.flags = (pixelSized ? PixelSized : 0) | (font.underline() ? Underline : 0)
+        | (font.strikeOut() ? StrikeOut : 0) | (font.fixedPitch() ? FixedPitch : 0);
+    h.familyLength = quint16(family.size());
+    h.postScriptNameLength = quint16(postScript.size());
+    h.styleNameLength = quint16(style.size());
+
+    QByteArray data(int(sizeof(Header)) + 2 * (family.size() + postScript.size() + style.size()), Qt::Uninitialized);
+    char *out = data.data();
+    convertHeader(h);
+    std::memcpy(out, &h, sizeof(h));
+    out += sizeof(h);
+    for (const QString *name : { &family, &postScript, &style }) {
+        for (const QChar c : *name) {
+            qToLittleEndian<quint16>(c.unicode(), out);
+            out += 2;
+        }
+    }
+    return fromData(data);
+}
+
+StoredFont StoredFont::fromData(const QByteArray &data)
+{
+    StoredFont stored;
+    if (data.size() < int(sizeof(Header))) {
+        return stored;
+    }
+    Header h;
+    std::memcpy(&h, data.constData(), sizeof(h));
+    convertHeader(h);
+    if (std::memcmp(h.magic, Magic, sizeof(Magic)) != 0 || h.version != Version
+            || h.headerSize < sizeof(Header)
+            || data.size() != h.headerSize + 2 * (h.familyLength + h.postScriptNameLength + h.styleNameLength)) {
+        return stored;
+    }
+    stored.m_header = h;
+    stored.m_data = data;
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    const bool inPlace = false;
+#else
+    const bool inPlace = (quintptr(data.constData()) & 1) == 0;
+#endif
+    if (!inPlace) {
+        // the names are viewed where they are, which needs host order and
+        // an aligned buffer
+        stored.m_data.detach();
+        char *name = stored.m_data.data() + h.headerSize;
+        for (char *end = stored.m_data.data() + stored.m_data.size(); name < end; name += 2) {
+            const quint16 c = qFromLittleEndian<quint16>(name);
+            std::memcpy(name, &c, 2);
+        }
+    }
+    return stored;
+}
+
+QStringView StoredFont::name(int offset, int length) const
+{
+    const char *start = m_data.constData() + m_header.headerSize + 2 * offset;
+    return QStringView(reinterpret_cast<const QChar *>(start), length);
+}
+
+QStringView StoredFont::family() const
+{
+    return name(0, m_header.familyLength);
+}
+
+QStringView StoredFont::postScriptName() const
+{
+    return name(m_header.familyLength, m_header.postScriptNameLength);
+}
+
+QStringView StoredFont::styleName() const
+{
+    return name(m_header.familyLength + m_header.postScriptNameLength, m_header.styleNameLength);
+}
+
+qreal StoredFont::pointSize() const
+{
+    double size;
+    std::memcpy(&size, &m_header.size, sizeof(size));
+    return (m_header.flags & PixelSized) ? -1 : size;
+}
+
+int StoredFont::pixelSize() const
+{
+    double size;
+    std::memcpy(&size, &m_header.size, sizeof(size));
+    return (m_header.flags & PixelSized) ? qRound(size) : -1;
+}
+
+QFont StoredFont::toFont(bool *faceChanged) const
+{
+    if (faceChanged) {
+        *faceChanged = false;
+    }
+    if (!isValid()) {
+        return QFont();
+    }
+    QFont font(family().toString());
+    if (pixelSize() > 0) {
+        font.setPixelSize(pixelSize());
+    } else if (pointSize() > 0) {
+        font.setPointSizeF(pointSize());
+    }
+    font.setWeight(toQtWeight(weight()));
+    font.setStyle(slant());
+    if (stretch() > 0) {
+        font.setStretch(stretch());
+    }
+    font.setStyleHint(QFont::StyleHint(m_header.styleHint));
+    if (m_header.flags & Underline) {
+        font.setUnderline(true);
+    }
+    if (m_header.flags & StrikeOut) {
+        font.setStrikeOut(true);
+    }
+    if (m_header.flags & FixedPitch) {
+        font.setFixedPitch(true);
+    }
+    if (!styleName().isEmpty()) {
+        font.setStyleName(styleName().toString());
+    }
+    if (postScriptName().isEmpty()) {
+        return font;
+    }
+
+    const QString storedPostScriptName = postScriptName().toString();
+    QRawFont raw = QRawFont::fromFont(font);
+    if (postScriptName(raw) != storedPostScriptName) {
+        const QString familyName = family().toString();
+        for (const QString &style : FontCatalog::instance()->styles(familyName)) {
+            QFont candidate(font);
+            candidate.setStyleName(style);
+            const QRawFont candidateRaw = QRawFont::fromFont(candidate);
+            if (postScriptName(candidateRaw) == storedPostScriptName) {
+                font = candidate;
+                raw = candidateRaw;
+                break;
+            }
+        }
+    }
+    if (faceChanged && contentHash() != 0 && raw.isValid()) {
+        *faceChanged = contentHash(raw) != contentHash();
+    }
+    return font;
+}
+
+int StoredFont::toOpenTypeWeight(int qtWeight)
+{
+    return interpolate(qtWeight, QtWeights, OpenTypeWeights);
+}
+
+int StoredFont::toQtWeight(int openTypeWeight)
+{
+    return interpolate(openTypeWeight, OpenTypeWeights, QtWeights);
+}
+
+QString StoredFont::postScriptName(const QRawFont &font)
+{
+    const QByteArray table = font.fontTable("name");
+    const uchar *data = reinterpret_cast<const uchar *>(table.constData());
+    if (table.size() < 6) {
+        return QString();
+    }
+    const int count = nameTableValue(data + 2);
+    const int stringOffset = nameTableValue(data + 4);
+    if (6 + count * 12 > table.size()) {
+        return QString();
+    }
+    QString macName;
+    for (int i = 0; i < count; ++i) {
+        const uchar *record = data + 6 + i * 12;
+        const int platformID = nameTableValue(record);
+        const int nameID = nameTableValue(record + 6);
+        const int length = nameTableValue(record + 8);
+        const int start = stringOffset + nameTableValue(record + 10);
+        if (nameID != 6 || start + length > table.size()) {
+            continue;
+        }
+        if (platformID == 0 || platformID == 3) {
+            // Unicode and Windows names are UTF-16BE
+            QString name(length / 2, Qt::Uninitialized);
+            for (int j = 0; j < name.size(); ++j) {
+                name[j] = QChar(nameTableValue(data + start + 2 * j));
+            }
+            return name;
+        }
+        if (platformID == 1 && macName.isEmpty()) {
+            // PostScript names are ASCII
+            macName = QString::fromLatin1(reinterpret_cast<const char *>(data + start), length);
+        }
+    }
+    return macName;
+}
+
+quint64 StoredFont::contentHash(const QRawFont &font)
+{
+    quint64 hash = Q_UINT64_C(0xcbf29ce484222325);
+    hash = fnv1a(font.fontTable("head"), hash);
+    hash = fnv1a(font.fontTable("name"), hash);
+    hash = fnv1a(font.fontTable("OS/2"), hash);
+    return hash;
+}
@@ -0,0 +1,126 @@
+/*!
+ *  @file storedfont.h
+ *
+ *  A compact, versioned binary description of a font for the settings,
+ *  which records the exact face: family, PostScript name and style name,
+ *  the weight on the OpenType scale, stretch, slant and size, and a hash of
+ *  the face's identifying tables.
+ *
+ */
+
+#ifndef STOREDFONT_H
+#define STOREDFONT_H
+
+#include <QByteArray>
+#include <QFont>
+#include <QStringView>
+
+class QRawFont;
+
+class StoredFont
+{
+public:
+    enum { Version = 1 };
+
+    StoredFont();
+
+    /**
+     * Describes @p font and the face it resolves to. Loads the font engine
+     * if it is not loaded yet.
+     */
+    static StoredFont fromFont(const QFont &font);
+
+    /**
+     * Wraps the stored bytes, which are only copied on big-endian hosts: the
+     * header is read in one go and the names are views into @p data.
+     * @return an invalid StoredFont if @p data is not a version 1 description
+     */
+    static StoredFont fromData(const QByteArray &data);
+
+    bool isValid() const
+    {
+        return !m_data.isEmpty();
+    }
+    QByteArray data() const
+    {
+        return m_data;
+    }
+
+    QStringView family() const;
+    QStringView postScriptName() const;
+    QStringView styleName() const;
+    int weight() const              ///< OpenType usWeightClass scale, 1 to 1000
+    {
+        return m_header.weight;
+    }
+    int stretch() const
+    {
+        return m_header.stretch;
+    }
+    QFont::Style slant() const
+    {
+        return QFont::Style(m_header.slant);
+    }
+    qreal pointSize() const;        ///< -1 for a pixel-sized font
+    int pixelSize() const;          ///< -1 for a point-sized font
+    quint64 contentHash() const
+    {
+        return m_header.contentHash;
+    }
+
+    /**
+     * The font as it was stored. When the family's style names no longer
+     * lead to the stored face, as happens when they are translated
+     * differently, the style with the stored PostScript name is chosen.
+     * @p faceChanged is set when the face found has different contents.
+     */
+    QFont toFont(bool *faceChanged = nullptr) const;
+
+    /**
+     * Qt 5 weights (0 to 99) and OpenType weights (1 to 1000), interpolated
+     * between the QFont::Weight values; each Qt weight maps back to itself.
+     */
+    static int toOpenTypeWeight(int qtWeight);
+    static int toQtWeight(int openTypeWeight);
+
+    /**
+     * The PostScript name (name ID 6) of @p font, and a hash of its 'head',
+     * 'name' and 'OS/2' tables.
+     */
+    static QString postScriptName(const QRawFont &font);
+    static quint64 contentHash(const QRawFont &font);
+
+private:
+    // The fixed layout at the start of the data, little-endian, followed by
+    // the UTF-16LE family, PostScript name and style name.
+    struct Header {
+        char magic[4];
+        quint16 version;
+        quint16 headerSize;     // later versions may append fields
+        quint64 contentHash;
+        quint64 size;           // the bits of a double: points, or pixels with PixelSized
+        quint16 weight;
+        quint16 stretch;
+        quint16 slant;
+        quint16 styleHint;
+        quint16 flags;
+        quint16 familyLength;   // in UTF-16 code units
+        quint16 postScriptNameLength;
+        quint16 styleNameLength;
+    };
+
+    enum Flag {
+        PixelSized = 0x01,
+        Underline = 0x02,
+        StrikeOut = 0x04,
+        FixedPitch = 0x08
+    };
+
+    static void convertHeader(Header &h);
+    QStringView name(int offset, int length) const;
+
+    QByteArray m_data;
+    Header m_header;
+};
+
+#endif // STOREDFONT_H
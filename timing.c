@@ -6,11 +6,13 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #ifdef __MACH__
 #	include <mach/mach.h>
 #	include <mach/mach_time.h>
 #	include <mach/mach_init.h>
+#	include <mach/thread_act.h>
 #	include <sys/sysctl.h>
 #endif
 #if defined(_MSC_VER) || defined(__WATCOMC__)
@@ -23,132 +25,180 @@
 #endif
 #include <errno.h>
 
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#	include <x86intrin.h>
+#	include <cpuid.h>
+#	define HRTIME_HAVE_TSC
+#endif
+
 #define _TIMING_C
 
 #include "timing.h"
 
+// this file is also #included and compiled as C++
+#if defined(__cplusplus)
+#	define HRTIME_THREAD_LOCAL	thread_local
+#elif defined(_MSC_VER)
+#	define HRTIME_THREAD_LOCAL	__declspec(thread)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#	define HRTIME_THREAD_LOCAL	_Thread_local
+#else
+#	define HRTIME_THREAD_LOCAL	__thread
+#endif
+
+// ---cycle counter---
+
+#ifdef HRTIME_HAVE_TSC
+
+static double tscSecondsPerCycle= 0, tscCyclesPerSecond= 0;
+static double tscBaseTime= 0;
+static unsigned long long tscBase= 0;
+static int haveRDTSCP= 0;
+
+static inline unsigned long long read_tsc()
+{
+	if( haveRDTSCP ){
+	  unsigned int aux;
+		// rdtscp waits for the preceding instructions to complete
+		return __rdtscp(&aux);
+	}
+	return __rdtsc();
+}
+
+	/* Calibrate the TSC against the given clock during ~20ms, and only if
+	 * it runs at a constant rate independent of frequency scaling and C-states.
+	 * The TSC time is expressed in the time base of that clock, so timings
+	 * started before the calibration remain valid.
+	 */
+static void calibrate_tsc( double (*reference)() )
+{ unsigned int eax, ebx, ecx, edx;
+  double t0, t1;
+  unsigned long long c0, c1;
+
+	if( tscSecondsPerCycle || getenv("HRTIME_NO_TSC") ){
+		return;
+	}
+	if( !__get_cpuid( 0x80000000, &eax, &ebx, &ecx, &edx ) || eax < 0x80000007 ){
+		return;
+	}
+	__get_cpuid( 0x80000007, &eax, &ebx, &ecx, &edx );
+	if( !(edx & (1 << 8)) ){
+		// no invariant TSC
+		return;
+	}
+	__get_cpuid( 0x80000001, &eax, &ebx, &ecx, &edx );
+	haveRDTSCP= (edx & (1 << 27)) != 0;
+
+	t0= (*reference)();
+	c0= read_tsc();
+	do{
+		t1= (*reference)();
+	} while( t1 - t0 < 0.02 );
+	c1= read_tsc();
+	if( c1 > c0 ){
+		tscCyclesPerSecond= (c1 - c0) / (t1 - t0);
+		tscBase= c1;
+		tscBaseTime= t1;
+		tscSecondsPerCycle= 1.0 / tscCyclesPerSecond;
+	}
+}
+
+#	define HAVE_CALIBRATED_TSC()	(tscSecondsPerCycle != 0)
+#	define TSC_TIME()	(tscBaseTime + ((double) (long long) (read_tsc() - tscBase)) * tscSecondsPerCycle)
+
+#else
+
+#	define HAVE_CALIBRATED_TSC()	0
+#	define TSC_TIME()	0
+
+#endif
+
 #if defined(__MACH__)
 
 static mach_timebase_info_data_t sTimebaseInfo;
 static double calibrator= 0;
 
-void init_HRTime()
+static double gettime()
 {
 	if( !calibrator ){
 		mach_timebase_info(&sTimebaseInfo);
 		  /* go from absolute time units to seconds (the timebase is calibrated in nanoseconds): */
 		calibrator= 1e-9 * sTimebaseInfo.numer / sTimebaseInfo.denom;
 	}
+	return mach_absolute_time() * calibrator;
 }
 
-double HRTime_Time()
-{
-	return mach_absolute_time() * calibrator;
+static double getcputime()
+{ thread_basic_info_data_t info;
+  mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+  mach_port_t thread = mach_thread_self();
+  double t = 0;
+
+	if( thread_info( thread, THREAD_BASIC_INFO, (thread_info_t) &info, &count ) == KERN_SUCCESS ){
+		t = info.user_time.seconds + info.user_time.microseconds * 1e-6
+			+ info.system_time.seconds + info.system_time.microseconds * 1e-6;
+	}
+	mach_port_deallocate( mach_task_self(), thread );
+	return t;
 }
 
-static double ticTime;
-double HRTime_tic()
+void init_HRTime()
 {
-	return( ticTime= mach_absolute_time() * calibrator );
+	gettime();
 }
 
-double HRTime_toc()
+const char *HRTime_Backend()
 {
-	return mach_absolute_time() * calibrator - ticTime;
+	return "mach_absolute_time";
 }
 
-
-#elif defined(linux)
+#elif defined(linux) || defined(__linux__)
 #pragma mark ---linux---
 
 #	if defined(CLOCK_MONOTONIC)
+#		define HRTIME_CLOCK	CLOCK_MONOTONIC
+#	else
+#		define HRTIME_CLOCK	CLOCK_REALTIME
+#	endif
 
-	static inline double gettime()
-	{ struct timespec hrt;
-		clock_gettime( CLOCK_MONOTONIC, &hrt );
-		return hrt.tv_sec + hrt.tv_nsec * 1e-9;
-	}
-
-	static inline double clock_get_res()
+	static double clock_time()
 	{ struct timespec hrt;
-		clock_getres( CLOCK_MONOTONIC, &hrt );
+		clock_gettime( HRTIME_CLOCK, &hrt );
 		return hrt.tv_sec + hrt.tv_nsec * 1e-9;
 	}
 
-#	elif defined(CLOCK_REALTIME)
-
 	static inline double gettime()
-	{ struct timespec hrt;
-		clock_gettime( CLOCK_REALTIME, &hrt );
-		return hrt.tv_sec + hrt.tv_nsec * 1e-9;
+	{
+		return HAVE_CALIBRATED_TSC()? TSC_TIME() : clock_time();
 	}
 
-	static inline double clock_get_res()
+	static double getcputime()
 	{ struct timespec hrt;
-		clock_getres( CLOCK_REALTIME, &hrt );
-		return hrt.tv_sec + hrt.tv_nsec * 1e-9;
-	}
-
-
-#	elif defined(CPUCLOCK_CYCLES_PER_SEC)
-
-	typedef unsigned long long tsc_time;
-
-	typedef struct tsc_timers{
-		tsc_time t1, t2;
-	} tsc_timers;
-
-	static __inline__ tsc_time read_tsc()
-	{ tsc_time ret;
-
-		__asm__ __volatile__("rdtsc": "=A" (ret));
-		/* no input, nothing else clobbered */
-		return ret;
-	}
-
-#	define tsc_get_time(t)  ((*(tsc_time*)t)=read_tsc())
-#	define tsc_time_to_sec(t) (((double) (*t)) / CPUCLOCK_CYCLES_PER_SEC)
-
-	static inline gettime()
-#		ifdef CPUCLOCK_CYCLES_PER_SEC
-	{ tsc_time t;
-		tsc_get_time(&t);
-		return tsc_time_to_sec( &t );
-	}
-#		else
-		  /* Use gettimeofday():	*/
-	{ struct timezone tzp;
-	  struct timeval ES_tv;
-
-		gettimeofday( &ES_tv, &tzp );
-		return ES_tv.tv_sec + ES_tv.tv_usec* 1e-6;
-	}
-#		endif
-
+#	if defined(CLOCK_THREAD_CPUTIME_ID)
+		if( clock_gettime( CLOCK_THREAD_CPUTIME_ID, &hrt ) == 0 ){
+			return hrt.tv_sec + hrt.tv_nsec * 1e-9;
+		}
 #	endif
+		return ((double) clock()) / CLOCKS_PER_SEC;
+	}
 
 void init_HRTime()
 {
-#if defined(CLOCK_MONOTONIC) || defined(CLOCK_REALTIME)
-	// just for kicks, probably not necessary:
-	clock_get_res();
+#ifdef HRTIME_HAVE_TSC
+	calibrate_tsc( clock_time );
 #endif
 }
 
-double HRTime_Time()
+const char *HRTime_Backend()
 {
-	return( gettime() );
-}
-
-static double ticTime;
-double HRTime_tic()
-{
-	return( ticTime= gettime() );
-}
-
-double HRTime_toc()
-{
-	return gettime() - ticTime;
+	if( HAVE_CALIBRATED_TSC() ){
+		return "TSC (calibrated against clock_gettime)";
+	}
+#	if defined(CLOCK_MONOTONIC)
+	return "clock_gettime(CLOCK_MONOTONIC)";
+#	else
+	return "clock_gettime(CLOCK_REALTIME)";
+#	endif
 }
 
 #elif defined(_WINDOWS) || defined(WIN32)
@@ -176,61 +226,139 @@ void init_HRTime()
 	}
 }
 
-
-double HRTime_Time()
+static double gettime()
 { LARGE_INTEGER count;
 
+	if( !calibrator ){
+		init_HRTime();
+	}
 	QueryPerformanceCounter(&count);
 	return count.QuadPart * calibrator;
 }
 
-static double ticTime;
-double HRTime_tic()
-{ LARGE_INTEGER count;
-	QueryPerformanceCounter(&count);
-	return( (ticTime= count.QuadPart * calibrator) );
+static double getcputime()
+{ FILETIME creation, exit, kernel, user;
+  ULARGE_INTEGER k, u;
+
+	if( !GetThreadTimes( GetCurrentThread(), &creation, &exit, &kernel, &user ) ){
+		return 0;
+	}
+	k.LowPart = kernel.dwLowDateTime; k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime; u.HighPart = user.dwHighDateTime;
+	  /* in units of 100ns */
+	return (k.QuadPart + u.QuadPart) * 1e-7;
 }
 
-double HRTime_toc()
-{ LARGE_INTEGER count;
-	QueryPerformanceCounter(&count);
-	return count.QuadPart * calibrator - ticTime;
+const char *HRTime_Backend()
+{
+	return "QueryPerformanceCounter";
 }
 
 #else
 
 
 	  /* Use gettimeofday():	*/
-#define gettime(time)	{ struct timezone tzp; \
-	  struct timeval ES_tv; \
-		gettimeofday( &ES_tv, &tzp ); \
-		time= ES_tv.tv_sec + ES_tv.tv_usec* 1e-6; \
-	}
+static double gettime()
+{ struct timezone tzp;
+  struct timeval ES_tv;
+
+	gettimeofday( &ES_tv, &tzp );
+	return ES_tv.tv_sec + ES_tv.tv_usec* 1e-6;
+}
+
+	  /* process time, the best we can do portably */
+static double getcputime()
+{
+	return ((double) clock()) / CLOCKS_PER_SEC;
+}
 
 void init_HRTime()
 {
 }
 
+const char *HRTime_Backend()
+{
+	return "gettimeofday";
+}
+
+#endif
+
+// ---common---
+
+typedef struct HRTimeStack {
+	double tic[HRTIME_STACK_DEPTH];
+	int depth;
+	double last;
+} HRTimeStack;
+
+static HRTIME_THREAD_LOCAL HRTimeStack wallStack, cpuStack;
+
+static inline double push_tic( HRTimeStack *stack, double t )
+{
+	if( stack->depth < HRTIME_STACK_DEPTH ){
+		stack->tic[stack->depth++]= t;
+	}
+	else{
+		// too deeply nested: restart the innermost measurement
+		stack->tic[HRTIME_STACK_DEPTH-1]= t;
+	}
+	return( stack->last= t );
+}
+
+static inline double pop_toc( HRTimeStack *stack, double t )
+{
+	if( stack->depth > 0 ){
+		stack->last= stack->tic[--stack->depth];
+	}
+	return t - stack->last;
+}
+
 double HRTime_Time()
-{ double time;
-	gettime(time);
-	return( time );
+{
+	return( gettime() );
 }
 
-static double ticTime;
 double HRTime_tic()
 {
-	gettime(ticTime);
-
-	return( ticTime );
+	return push_tic( &wallStack, gettime() );
 }
 
 double HRTime_toc()
-{ double time;
-	gettime(time);
-	return time - ticTime;
+{
+	return pop_toc( &wallStack, gettime() );
+}
+
+double HRTime_ThreadCPUTime()
+{
+	return( getcputime() );
+}
+
+double HRTime_CPUtic()
+{
+	return push_tic( &cpuStack, getcputime() );
+}
+
+double HRTime_CPUtoc()
+{
+	return pop_toc( &cpuStack, getcputime() );
 }
 
+unsigned long long HRTime_Cycles()
+{
+#ifdef HRTIME_HAVE_TSC
+	return read_tsc();
+#else
+	return 0;
+#endif
+}
+
+double HRTime_CyclesPerSecond()
+{
+#ifdef HRTIME_HAVE_TSC
+	return tscCyclesPerSecond;
+#else
+	return 0;
 #endif
+}
 
 #undef _TIMING_C
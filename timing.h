@@ -18,16 +18,40 @@
 #	define TIMINGext /**/
 #endif
 
+// maximum nesting depth of HRTime_tic() and HRTime_CPUtic() per thread
+#define HRTIME_STACK_DEPTH	32
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
+// Initialise the clocks; calibrates the CPU cycle counter where one is used.
+// Call this once from the main thread before any other thread uses the timers.
 TIMINGext extern void init_HRTime();
+// the current wall-clock (monotonic) time in seconds
 TIMINGext extern double HRTime_Time();
+// HRTime_tic() pushes the current time on a per-thread stack and returns it;
+// HRTime_toc() pops the most recent tic and returns the time elapsed since.
+// tic/toc pairs can thus be nested (up to HRTIME_STACK_DEPTH) and used from
+// several threads at once. A toc without a pending tic measures from the
+// last tic that was popped, as the original single-timer implementation did.
 TIMINGext extern double HRTime_tic();
 TIMINGext extern double HRTime_toc();
 
+// the CPU time consumed by the calling thread, in seconds
+TIMINGext extern double HRTime_ThreadCPUTime();
+// as HRTime_tic()/HRTime_toc(), but measuring the calling thread's CPU time
+TIMINGext extern double HRTime_CPUtic();
+TIMINGext extern double HRTime_CPUtoc();
+
+// the raw cycle counter and its calibrated frequency; the frequency is 0
+// when no usable (invariant) cycle counter is available.
+TIMINGext extern unsigned long long HRTime_Cycles();
+TIMINGext extern double HRTime_CyclesPerSecond();
+// a short description of the clock behind HRTime_Time()
+TIMINGext extern const char *HRTime_Backend();
+
 #ifdef __cplusplus
 }
 #endif